@@ -0,0 +1,441 @@
+#include "catalogue_snapshot.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "transport_catalogue.h"
+
+namespace transport_catalogue {
+
+    namespace {
+        using namespace std::string_literals;
+
+        // Формат образа: заголовок и разделы, каждый с начала, выровненного по 8 байт.
+        // Числа записаны в порядке байтов той машины, на которой образ построен
+        const char SNAPSHOT_MAGIC[8] = {'T', 'C', 'S', 'N', 'A', 'P', 'S', 'H'};
+        const uint32_t SNAPSHOT_VERSION = 2;
+        const uint32_t BYTE_ORDER_MARK = 0x01020304;
+        const size_t SECTION_ALIGNMENT = 8;
+
+        enum Section : uint32_t {
+            NAMES,
+            STOP_NAME_OFFSETS,
+            BUS_NAME_OFFSETS,
+            STOP_HASH_DISPLACEMENTS,
+            STOP_HASH_SLOTS,
+            BUS_HASH_DISPLACEMENTS,
+            BUS_HASH_SLOTS,
+            STOP_COORDINATES,
+            STOP_BUS_OFFSETS,
+            STOP_BUS_IDS,
+            DISTANCE_OFFSETS,
+            DISTANCE_TARGETS,
+            DISTANCE_VALUES,
+            BUS_IS_ROUNDTRIP,
+            BUS_END_STOPS,
+            BUS_STOP_OFFSETS,
+            BUS_STOP_IDS,
+            BUS_STATS,
+            METADATA,
+            SECTION_COUNT,
+        };
+
+        // Смещение и длина раздела в байтах от начала образа
+        struct SectionRef {
+            uint64_t offset;
+            uint64_t size;
+        };
+
+        struct SnapshotHeader {
+            char magic[8];
+            uint32_t version;
+            uint32_t byte_order;
+            // Хеш всех разделов, кроме метаданных
+            uint64_t content_hash;
+            SectionRef sections[SECTION_COUNT];
+        };
+
+        static_assert(std::is_trivially_copyable_v<geo::Coordinates> && sizeof(geo::Coordinates) == 2 * sizeof(double));
+
+        size_t AlignUp(size_t size) {
+            return (size + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+        }
+
+        // Собирает образ снимка из массивов
+        class ImageBuilder {
+        public:
+            ImageBuilder()
+                : image_(sizeof(SnapshotHeader), '\0') {
+                std::memcpy(header_.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+                header_.version = SNAPSHOT_VERSION;
+                header_.byte_order = BYTE_ORDER_MARK;
+            }
+
+            template <typename T>
+            void Add(Section section, const std::vector<T>& values) {
+                static_assert(std::is_trivially_copyable_v<T>);
+                Add(section, std::string_view(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T)));
+            }
+
+            void Add(Section section, std::string_view bytes) {
+                image_.resize(AlignUp(image_.size()), '\0');
+                header_.sections[section] = SectionRef{image_.size(), bytes.size()};
+                image_ += bytes;
+            }
+
+            // Раздел метаданных должен быть пуст: Save дописывает его в конец файла
+            std::vector<uint64_t> Build() {
+                image_.resize(AlignUp(image_.size()), '\0');
+                header_.content_hash = PerfectHash::Hash(std::string_view(image_).substr(sizeof(header_)));
+                std::memcpy(image_.data(), &header_, sizeof(header_));
+                std::vector<uint64_t> result(image_.size() / sizeof(uint64_t));
+                std::memcpy(result.data(), image_.data(), image_.size());
+                return result;
+            }
+
+        private:
+            SnapshotHeader header_{};
+            std::string image_;
+        };
+
+        template <typename T>
+        CatalogueSnapshot::ArrayView<T> GetSection(const SnapshotHeader& header, std::string_view image, Section section) {
+            const SectionRef& ref = header.sections[section];
+            if (ref.offset > image.size() || ref.size > image.size() - ref.offset
+                || ref.offset % alignof(T) != 0 || ref.size % sizeof(T) != 0) {
+                throw std::runtime_error("Corrupted catalogue snapshot"s);
+            }
+            const T* begin = reinterpret_cast<const T*>(image.data() + ref.offset);
+            return {begin, begin + ref.size / sizeof(T)};
+        }
+
+        // Массив смещений CSR: count + 1 неубывающий элемент, последний указывает на конец массива значений
+        void CheckOffsets(CatalogueSnapshot::ArrayView<uint32_t> offsets, size_t count, size_t values_size) {
+            if (offsets.size() != count + 1 || offsets[count] != values_size
+                || !std::is_sorted(offsets.begin(), offsets.end())) {
+                throw std::runtime_error("Corrupted catalogue snapshot"s);
+            }
+        }
+
+        // Каждый номер меньше count, кроме разрешённого значения-признака allowed
+        void CheckIds(CatalogueSnapshot::ArrayView<uint32_t> ids, size_t count,
+                      std::optional<uint32_t> allowed = std::nullopt) {
+            for (const uint32_t id : ids) {
+                if (id >= count && id != allowed) {
+                    throw std::runtime_error("Corrupted catalogue snapshot"s);
+                }
+            }
+        }
+    }
+
+    CatalogueSnapshot::CatalogueSnapshot(const TransportCatalogue& catalogue) {
+        const size_t stops_count = catalogue.GetStopsCount();
+        const size_t buses_count = catalogue.GetBusesCount();
+
+        size_t names_size = 0;
+        for (domain::StopId stop = 0; stop < stops_count; ++stop) {
+            names_size += catalogue.GetStopName(stop).size();
+        }
+        for (domain::BusId bus = 0; bus < buses_count; ++bus) {
+            names_size += catalogue.GetBusName(bus).size();
+        }
+        std::string names;
+        names.reserve(names_size);
+
+        std::vector<uint32_t> stop_name_offsets;
+        std::vector<geo::Coordinates> stop_coordinates;
+        std::vector<uint32_t> stop_bus_offsets;
+        std::vector<domain::BusId> stop_bus_ids;
+        stop_name_offsets.reserve(stops_count + 1);
+        stop_coordinates.reserve(stops_count);
+        stop_bus_offsets.reserve(stops_count + 1);
+        stop_bus_offsets.push_back(0);
+        for (domain::StopId stop = 0; stop < stops_count; ++stop) {
+            stop_name_offsets.push_back(static_cast<uint32_t>(names.size()));
+            names += catalogue.GetStopName(stop);
+            stop_coordinates.push_back(catalogue.GetStopCoordinates(stop));
+            for (const domain::BusId bus : catalogue.GetStopBuses(stop)) {
+                stop_bus_ids.push_back(bus);
+            }
+            stop_bus_offsets.push_back(static_cast<uint32_t>(stop_bus_ids.size()));
+        }
+        stop_name_offsets.push_back(static_cast<uint32_t>(names.size()));
+
+        // Расстояния раскладываются по остановке отправления и упорядочиваются по остановке назначения
+        std::vector<uint32_t> distance_offsets(stops_count + 1, 0);
+        catalogue.ForEachDistance([&distance_offsets](domain::StopId from, domain::StopId, double) {
+            ++distance_offsets[from + 1];
+        });
+        for (size_t stop = 0; stop < stops_count; ++stop) {
+            distance_offsets[stop + 1] += distance_offsets[stop];
+        }
+        std::vector<std::pair<domain::StopId, double>> distances(distance_offsets.back());
+        std::vector<uint32_t> positions(distance_offsets.begin(), distance_offsets.end() - 1);
+        catalogue.ForEachDistance([&distances, &positions](domain::StopId from, domain::StopId to, double distance) {
+            distances[positions[from]++] = {to, distance};
+        });
+        std::vector<domain::StopId> distance_targets;
+        std::vector<double> distance_values;
+        distance_targets.reserve(distances.size());
+        distance_values.reserve(distances.size());
+        for (size_t stop = 0; stop < stops_count; ++stop) {
+            const auto first = distances.begin() + distance_offsets[stop];
+            const auto last = distances.begin() + distance_offsets[stop + 1];
+            std::sort(first, last);
+            for (auto it = first; it != last; ++it) {
+                distance_targets.push_back(it->first);
+                distance_values.push_back(it->second);
+            }
+        }
+
+        std::vector<uint32_t> bus_name_offsets;
+        std::vector<char> bus_is_roundtrip;
+        std::vector<domain::StopId> bus_end_stops(buses_count, NO_STOP);
+        std::vector<uint32_t> bus_stop_offsets;
+        std::vector<domain::StopId> bus_stop_ids;
+        std::vector<BusStats> bus_stats;
+        bus_name_offsets.reserve(buses_count + 1);
+        bus_is_roundtrip.reserve(buses_count);
+        bus_stop_offsets.reserve(buses_count + 1);
+        bus_stop_offsets.push_back(0);
+        bus_stats.reserve(buses_count);
+        for (domain::BusId bus = 0; bus < buses_count; ++bus) {
+            bus_name_offsets.push_back(static_cast<uint32_t>(names.size()));
+            names += catalogue.GetBusName(bus);
+            bus_is_roundtrip.push_back(catalogue.IsRoundtrip(bus) ? 1 : 0);
+            for (const domain::StopId stop : catalogue.GetBusStops(bus)) {
+                bus_stop_ids.push_back(stop);
+            }
+            bus_stop_offsets.push_back(static_cast<uint32_t>(bus_stop_ids.size()));
+
+            const domain::BusInfo info = catalogue.GetBusInfo(bus);
+            bus_stats.push_back(BusStats{static_cast<uint32_t>(info.count_all_stops),
+                                         static_cast<uint32_t>(info.count_unique_stops),
+                                         info.geo_length, info.route_length});
+        }
+        bus_name_offsets.push_back(static_cast<uint32_t>(names.size()));
+        catalogue.ForEachBus([&bus_end_stops](const domain::Bus& bus) {
+            if (bus.end_stop_ != nullptr) {
+                bus_end_stops[bus.id_] = bus.end_stop_->id;
+            }
+        });
+
+        const auto get_name = [&names](const std::vector<uint32_t>& offsets, size_t id) {
+            return std::string_view(names).substr(offsets[id], offsets[id + 1] - offsets[id]);
+        };
+        std::vector<std::string_view> keys;
+        keys.reserve(stops_count);
+        for (domain::StopId stop = 0; stop < stops_count; ++stop) {
+            keys.push_back(get_name(stop_name_offsets, stop));
+        }
+        const PerfectHash stop_index(keys);
+
+        keys.clear();
+        for (domain::BusId bus = 0; bus < buses_count; ++bus) {
+            keys.push_back(get_name(bus_name_offsets, bus));
+        }
+        const PerfectHash bus_index(keys);
+
+        ImageBuilder builder;
+        builder.Add(NAMES, names);
+        builder.Add(STOP_NAME_OFFSETS, stop_name_offsets);
+        builder.Add(BUS_NAME_OFFSETS, bus_name_offsets);
+        builder.Add(STOP_HASH_DISPLACEMENTS, stop_index.GetDisplacements());
+        builder.Add(STOP_HASH_SLOTS, stop_index.GetSlots());
+        builder.Add(BUS_HASH_DISPLACEMENTS, bus_index.GetDisplacements());
+        builder.Add(BUS_HASH_SLOTS, bus_index.GetSlots());
+        builder.Add(STOP_COORDINATES, stop_coordinates);
+        builder.Add(STOP_BUS_OFFSETS, stop_bus_offsets);
+        builder.Add(STOP_BUS_IDS, stop_bus_ids);
+        builder.Add(DISTANCE_OFFSETS, distance_offsets);
+        builder.Add(DISTANCE_TARGETS, distance_targets);
+        builder.Add(DISTANCE_VALUES, distance_values);
+        builder.Add(BUS_IS_ROUNDTRIP, bus_is_roundtrip);
+        builder.Add(BUS_END_STOPS, bus_end_stops);
+        builder.Add(BUS_STOP_OFFSETS, bus_stop_offsets);
+        builder.Add(BUS_STOP_IDS, bus_stop_ids);
+        builder.Add(BUS_STATS, bus_stats);
+        builder.Add(METADATA, std::string_view{});
+        image_ = builder.Build();
+        Attach(GetImage());
+    }
+
+    CatalogueSnapshot CatalogueSnapshot::Load(const std::string& path) {
+        CatalogueSnapshot result;
+        result.file_.emplace(path, io::MappedFile::Access::RANDOM);
+        result.Attach(result.GetImage());
+        // Файл мог быть обрезан или перезаписан не целиком: содержимое сверяется с хешем из заголовка
+        const std::string_view image = result.GetImage();
+        const SectionRef& metadata = reinterpret_cast<const SnapshotHeader*>(image.data())->sections[METADATA];
+        const size_t content_end = std::min<size_t>(image.size(), metadata.offset);
+        if (PerfectHash::Hash(image.substr(sizeof(SnapshotHeader), content_end - sizeof(SnapshotHeader))) != result.content_hash_) {
+            throw std::runtime_error("Corrupted catalogue snapshot"s);
+        }
+        return result;
+    }
+
+    void CatalogueSnapshot::Save(const std::string& path, std::string_view metadata) const {
+        // Образ записывается как есть, только раздел метаданных в заголовке указывает на конец файла
+        const std::string_view image = GetImage();
+        SnapshotHeader header;
+        std::memcpy(&header, image.data(), sizeof(header));
+        const size_t metadata_offset = AlignUp(image.size());
+        header.sections[METADATA] = SectionRef{metadata_offset, metadata.size()};
+
+        // Файл заменяется целиком: работающий serve продолжает читать отображённый старый снимок
+        io::ReplaceFile(path, [&](std::ostream& output) {
+            output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            output.write(image.data() + sizeof(header), static_cast<std::streamsize>(image.size() - sizeof(header)));
+            const std::string padding(metadata_offset - image.size(), '\0');
+            output.write(padding.data(), static_cast<std::streamsize>(padding.size()));
+            output.write(metadata.data(), static_cast<std::streamsize>(metadata.size()));
+        });
+    }
+
+    std::string_view CatalogueSnapshot::GetImage() const {
+        if (file_) {
+            return file_->GetData();
+        }
+        return {reinterpret_cast<const char*>(image_.data()), image_.size() * sizeof(uint64_t)};
+    }
+
+    void CatalogueSnapshot::Attach(std::string_view image) {
+        SnapshotHeader header;
+        if (image.size() < sizeof(header)) {
+            throw std::runtime_error("Not a catalogue snapshot"s);
+        }
+        std::memcpy(&header, image.data(), sizeof(header));
+        if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+            throw std::runtime_error("Not a catalogue snapshot"s);
+        }
+        if (header.version != SNAPSHOT_VERSION || header.byte_order != BYTE_ORDER_MARK) {
+            throw std::runtime_error("Unsupported catalogue snapshot version"s);
+        }
+
+        const auto names = GetSection<char>(header, image, NAMES);
+        names_ = std::string_view(names.begin(), names.size());
+        stop_name_offsets_ = GetSection<uint32_t>(header, image, STOP_NAME_OFFSETS);
+        bus_name_offsets_ = GetSection<uint32_t>(header, image, BUS_NAME_OFFSETS);
+        stop_hash_displacements_ = GetSection<uint32_t>(header, image, STOP_HASH_DISPLACEMENTS);
+        stop_hash_slots_ = GetSection<uint32_t>(header, image, STOP_HASH_SLOTS);
+        bus_hash_displacements_ = GetSection<uint32_t>(header, image, BUS_HASH_DISPLACEMENTS);
+        bus_hash_slots_ = GetSection<uint32_t>(header, image, BUS_HASH_SLOTS);
+        stop_coordinates_ = GetSection<geo::Coordinates>(header, image, STOP_COORDINATES);
+        stop_bus_offsets_ = GetSection<uint32_t>(header, image, STOP_BUS_OFFSETS);
+        stop_bus_ids_ = GetSection<domain::BusId>(header, image, STOP_BUS_IDS);
+        distance_offsets_ = GetSection<uint32_t>(header, image, DISTANCE_OFFSETS);
+        distance_targets_ = GetSection<domain::StopId>(header, image, DISTANCE_TARGETS);
+        distance_values_ = GetSection<double>(header, image, DISTANCE_VALUES);
+        bus_is_roundtrip_ = GetSection<char>(header, image, BUS_IS_ROUNDTRIP);
+        bus_end_stops_ = GetSection<domain::StopId>(header, image, BUS_END_STOPS);
+        bus_stop_offsets_ = GetSection<uint32_t>(header, image, BUS_STOP_OFFSETS);
+        bus_stop_ids_ = GetSection<domain::StopId>(header, image, BUS_STOP_IDS);
+        bus_stats_ = GetSection<BusStats>(header, image, BUS_STATS);
+        content_hash_ = header.content_hash;
+        const auto metadata = GetSection<char>(header, image, METADATA);
+        metadata_ = std::string_view(metadata.begin(), metadata.size());
+
+        // Размеры разделов и все номера и смещения проверяются за один проход, чтобы повреждённый
+        // образ не приводил к чтению за пределами массивов
+        const size_t stops_count = stop_coordinates_.size();
+        const size_t buses_count = bus_is_roundtrip_.size();
+        if (bus_name_offsets_.size() != buses_count + 1) {
+            throw std::runtime_error("Corrupted catalogue snapshot"s);
+        }
+        // Названия маршрутов идут в names_ сразу за названиями остановок
+        CheckOffsets(stop_name_offsets_, stops_count, bus_name_offsets_[0]);
+        CheckOffsets(bus_name_offsets_, buses_count, names_.size());
+        CheckOffsets(stop_bus_offsets_, stops_count, stop_bus_ids_.size());
+        CheckOffsets(distance_offsets_, stops_count, distance_targets_.size());
+        CheckOffsets(bus_stop_offsets_, buses_count, bus_stop_ids_.size());
+        if (distance_values_.size() != distance_targets_.size() || bus_end_stops_.size() != buses_count
+            || bus_stats_.size() != buses_count || stop_hash_slots_.size() != stops_count
+            || bus_hash_slots_.size() != buses_count
+            || (stops_count > 0 && stop_hash_displacements_.empty())
+            || (buses_count > 0 && bus_hash_displacements_.empty())) {
+            throw std::runtime_error("Corrupted catalogue snapshot"s);
+        }
+        CheckIds(stop_hash_slots_, stops_count);
+        CheckIds(bus_hash_slots_, buses_count);
+        CheckIds(stop_bus_ids_, buses_count);
+        CheckIds(bus_stop_ids_, stops_count);
+        CheckIds(bus_end_stops_, stops_count, NO_STOP);
+        CheckIds(distance_targets_, stops_count);
+        // Поиск расстояния двоичный, поэтому назначения каждой остановки должны идти по возрастанию
+        for (size_t stop = 0; stop < stops_count; ++stop) {
+            if (!std::is_sorted(distance_targets_.begin() + distance_offsets_[stop],
+                                distance_targets_.begin() + distance_offsets_[stop + 1])) {
+                throw std::runtime_error("Corrupted catalogue snapshot"s);
+            }
+        }
+    }
+
+    std::optional<domain::StopId> CatalogueSnapshot::FindStop(std::string_view name) const {
+        const auto id = PerfectHash::Lookup(name, stop_hash_displacements_.begin(), stop_hash_displacements_.size(),
+                                            stop_hash_slots_.begin(), stop_hash_slots_.size());
+        if (!id || GetStopName(*id) != name) {
+            return std::nullopt;
+        }
+        return *id;
+    }
+
+    std::optional<domain::BusId> CatalogueSnapshot::FindBus(std::string_view name) const {
+        const auto id = PerfectHash::Lookup(name, bus_hash_displacements_.begin(), bus_hash_displacements_.size(),
+                                            bus_hash_slots_.begin(), bus_hash_slots_.size());
+        if (!id || GetBusName(*id) != name) {
+            return std::nullopt;
+        }
+        return *id;
+    }
+
+    std::optional<double> CatalogueSnapshot::FindDistance(domain::StopId from, domain::StopId to) const {
+        const auto first = distance_targets_.begin() + distance_offsets_[from];
+        const auto last = distance_targets_.begin() + distance_offsets_[from + 1];
+        const auto it = std::lower_bound(first, last, to);
+        if (it == last || *it != to) {
+            return std::nullopt;
+        }
+        return distance_values_[static_cast<size_t>(it - distance_targets_.begin())];
+    }
+
+    double CatalogueSnapshot::GetDistance(domain::StopId from, domain::StopId to) const {
+        if (const auto distance = FindDistance(from, to)) {
+            return *distance;
+        }
+        return FindDistance(to, from).value_or(0.0);
+    }
+
+    domain::BusInfo CatalogueSnapshot::GetBusInfo(std::string_view name) const {
+        const auto id = FindBus(name);
+        if (!id) {
+            return {};
+        }
+
+        const BusStats& stats = bus_stats_[*id];
+        domain::BusInfo result;
+        result.name = name;
+        result.count_all_stops = stats.count_all_stops;
+        result.count_unique_stops = stats.count_unique_stops;
+        result.geo_length = stats.geo_length;
+        result.route_length = stats.route_length;
+        result.route_curvature = stats.route_length / stats.geo_length;
+        return result;
+    }
+
+    domain::StopInfo CatalogueSnapshot::GetStopInfo(std::string_view name) const {
+        domain::StopInfo result;
+
+        if (const auto id = FindStop(name)) {
+            result.name = name;
+            for (const domain::BusId bus : GetStopBuses(*id)) {
+                result.buses.insert(result.buses.end(), GetBusName(bus));
+            }
+        }
+
+        return result;
+    }
+
+};
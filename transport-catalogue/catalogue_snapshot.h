@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "domain.h"
+#include "mapped_file.h"
+#include "perfect_hash.h"
+#include "ranges.h"
+
+namespace transport_catalogue {
+
+    class TransportCatalogue;
+
+    // Неизменяемый снимок справочника, который строит TransportCatalogue::Freeze().
+    // Названия остановок и маршрутов лежат подряд в одной строке, данные остановок и маршрутов —
+    // в плоских массивах по StopId/BusId, поиск по названию идёт через совершенную хеш-функцию.
+    // Снимок не меняется после построения, поэтому его можно читать из любого числа потоков
+    // без блокировок.
+    // Все массивы снимка размещены в одном двоичном образе. Save записывает образ в файл как есть,
+    // а Load отображает файл в память, и снимок работает с ним на месте, без разбора и копирования
+    class CatalogueSnapshot {
+    public:
+        template <typename T>
+        using ArrayView = ranges::Range<const T*>;
+        using StopIdsRange = ArrayView<domain::StopId>;
+        using BusIdsRange = ArrayView<domain::BusId>;
+
+        explicit CatalogueSnapshot(const TransportCatalogue& catalogue);
+
+        // Бросает std::runtime_error, если файл не удалось прочитать, он повреждён
+        // или записан другой версией формата
+        static CatalogueSnapshot Load(const std::string& path);
+
+        // metadata — произвольные данные приложения, сохраняемые вместе со снимком
+        // (например, настройки отрисовки и маршрутизации); после Load их возвращает GetMetadata
+        void Save(const std::string& path, std::string_view metadata = {}) const;
+
+        // Представления ссылаются на образ, которым владеет снимок, поэтому копировать его нельзя
+        CatalogueSnapshot(const CatalogueSnapshot&) = delete;
+        CatalogueSnapshot& operator=(const CatalogueSnapshot&) = delete;
+        CatalogueSnapshot(CatalogueSnapshot&&) = default;
+        CatalogueSnapshot& operator=(CatalogueSnapshot&&) = default;
+
+        std::optional<domain::StopId> FindStop(std::string_view name) const;
+        std::optional<domain::BusId> FindBus(std::string_view name) const;
+
+        domain::BusInfo GetBusInfo(std::string_view name) const;
+        domain::StopInfo GetStopInfo(std::string_view name) const;
+
+        size_t GetStopsCount() const {
+            return stop_coordinates_.size();
+        }
+
+        size_t GetBusesCount() const {
+            return bus_is_roundtrip_.size();
+        }
+
+        std::string_view GetStopName(domain::StopId id) const {
+            return GetName(stop_name_offsets_, id);
+        }
+
+        std::string_view GetBusName(domain::BusId id) const {
+            return GetName(bus_name_offsets_, id);
+        }
+
+        const geo::Coordinates& GetStopCoordinates(domain::StopId id) const {
+            return stop_coordinates_[id];
+        }
+
+        bool IsRoundtrip(domain::BusId id) const {
+            return bus_is_roundtrip_[id] != 0;
+        }
+
+        // Конечная остановка маршрута; для маршрута без остановок — nullopt
+        std::optional<domain::StopId> GetBusEndStop(domain::BusId id) const {
+            const domain::StopId stop = bus_end_stops_[id];
+            return stop == NO_STOP ? std::nullopt : std::optional<domain::StopId>(stop);
+        }
+
+        StopIdsRange GetBusStops(domain::BusId id) const {
+            return {bus_stop_ids_.begin() + bus_stop_offsets_[id], bus_stop_ids_.begin() + bus_stop_offsets_[id + 1]};
+        }
+
+        BusIdsRange GetStopBuses(domain::StopId id) const {
+            return {stop_bus_ids_.begin() + stop_bus_offsets_[id], stop_bus_ids_.begin() + stop_bus_offsets_[id + 1]};
+        }
+
+        // Дорожное расстояние from -> to, а если оно не задано — to -> from; 0, если нет обоих
+        double GetDistance(domain::StopId from, domain::StopId to) const;
+
+        std::string_view GetMetadata() const {
+            return metadata_;
+        }
+
+        // Хеш содержимого снимка без метаданных: совпадает у снимка и у его копии, загруженной из файла
+        uint64_t GetContentHash() const {
+            return content_hash_;
+        }
+
+    private:
+        // Статистика маршрута без названия: название берётся из общей строки names_
+        struct BusStats {
+            uint32_t count_all_stops;
+            uint32_t count_unique_stops;
+            double geo_length;
+            double route_length;
+        };
+
+        static constexpr domain::StopId NO_STOP = static_cast<domain::StopId>(-1);
+
+        CatalogueSnapshot() = default;
+
+        // Настраивает представления на образ; бросает std::runtime_error, если образ некорректен
+        void Attach(std::string_view image);
+        std::string_view GetImage() const;
+        std::optional<double> FindDistance(domain::StopId from, domain::StopId to) const;
+
+        std::string_view GetName(ArrayView<uint32_t> offsets, uint32_t id) const {
+            return names_.substr(offsets[id], offsets[id + 1] - offsets[id]);
+        }
+
+        // Владелец образа: построенный в памяти (выровнен по 8 байт) либо отображённый файл
+        std::vector<uint64_t> image_;
+        std::optional<io::MappedFile> file_;
+
+        std::string_view names_;
+        ArrayView<uint32_t> stop_name_offsets_;
+        ArrayView<uint32_t> bus_name_offsets_;
+        // Таблицы совершенных хеш-функций по названиям, см. PerfectHash
+        ArrayView<uint32_t> stop_hash_displacements_;
+        ArrayView<uint32_t> stop_hash_slots_;
+        ArrayView<uint32_t> bus_hash_displacements_;
+        ArrayView<uint32_t> bus_hash_slots_;
+
+        ArrayView<geo::Coordinates> stop_coordinates_;
+        ArrayView<uint32_t> stop_bus_offsets_;
+        ArrayView<domain::BusId> stop_bus_ids_;
+        // Расстояния от остановки id: distance_targets_/distance_values_[distance_offsets_[id] ..
+        // distance_offsets_[id + 1]), упорядочены по остановке назначения
+        ArrayView<uint32_t> distance_offsets_;
+        ArrayView<domain::StopId> distance_targets_;
+        ArrayView<double> distance_values_;
+
+        ArrayView<char> bus_is_roundtrip_;
+        ArrayView<domain::StopId> bus_end_stops_;
+        ArrayView<uint32_t> bus_stop_offsets_;
+        ArrayView<domain::StopId> bus_stop_ids_;
+        ArrayView<BusStats> bus_stats_;
+
+        std::string_view metadata_;
+        uint64_t content_hash_ = 0;
+    };
+
+};
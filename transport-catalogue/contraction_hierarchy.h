@@ -0,0 +1,472 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Иерархия сжатия (contraction hierarchy). При построении вершины графа по очереди
+// "стягиваются" в порядке возрастания важности, а кратчайшие пути через стянутую вершину
+// сохраняются ярлыками (shortcut). Запрос BuildRoute — двунаправленный поиск Дейкстры,
+// который идёт только по рёбрам к более важным вершинам, после чего ярлыки
+// разворачиваются обратно в рёбра исходного графа.
+template <typename Weight>
+class ContractionHierarchy {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    using RouteInfo = typename Router<Weight>::RouteInfo;
+
+    explicit ContractionHierarchy(const Graph& graph);
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+
+    const Graph& GetGraph() const {
+        return graph_;
+    }
+
+    size_t GetShortcutCount() const {
+        return edges_.size() - graph_.GetEdgeCount();
+    }
+
+private:
+    static constexpr size_t NO_EDGE = std::numeric_limits<size_t>::max();
+    // Ограничение на число вершин, просматриваемых при поиске пути-свидетеля.
+    // Если свидетель не найден за это число шагов, добавляется лишний, но корректный ярлык
+    static constexpr size_t WITNESS_SETTLE_LIMIT = 500;
+
+    // Ребро иерархии: либо ребро исходного графа (original_edge), либо ярлык,
+    // заменяющий пару рёбер иерархии first и second
+    struct HierarchyEdge {
+        VertexId from;
+        VertexId to;
+        Weight weight;
+        EdgeId original_edge;
+        size_t first;
+        size_t second;
+    };
+
+    struct Arc {
+        VertexId vertex;
+        size_t edge;
+    };
+
+    using QueueItem = std::pair<Weight, VertexId>;
+
+    // Массивы одного поиска Дейкстры, метки stamps позволяют не очищать их между поисками
+    struct SearchBuffers {
+        std::vector<Weight> weights;
+        std::vector<size_t> prev_edges;
+        std::vector<uint32_t> stamps;
+        std::vector<QueueItem> queue;
+        uint32_t stamp = 0;
+
+        void Prepare(size_t vertex_count) {
+            if (stamps.size() < vertex_count) {
+                weights.resize(vertex_count);
+                prev_edges.resize(vertex_count);
+                stamps.resize(vertex_count, 0);
+            }
+            if (++stamp == 0) {
+                std::fill(stamps.begin(), stamps.end(), 0);
+                stamp = 1;
+            }
+            queue.clear();
+        }
+
+        bool IsReached(VertexId vertex) const {
+            return stamps[vertex] == stamp;
+        }
+
+        bool Relax(VertexId vertex, Weight weight, size_t edge) {
+            if (IsReached(vertex) && !(weight < weights[vertex])) {
+                return false;
+            }
+            stamps[vertex] = stamp;
+            weights[vertex] = weight;
+            prev_edges[vertex] = edge;
+            queue.emplace_back(weight, vertex);
+            std::push_heap(queue.begin(), queue.end(), std::greater<QueueItem>{});
+            return true;
+        }
+
+        QueueItem Pop() {
+            std::pop_heap(queue.begin(), queue.end(), std::greater<QueueItem>{});
+            const QueueItem item = queue.back();
+            queue.pop_back();
+            return item;
+        }
+    };
+
+    struct QueryBuffers {
+        SearchBuffers forward;
+        SearchBuffers backward;
+    };
+
+    // Состояние предварительной обработки, после построения иерархии не нужно
+    struct ContractionState {
+        std::vector<std::vector<Arc>> out_arcs;
+        std::vector<std::vector<Arc>> in_arcs;
+        std::vector<bool> contracted;
+        std::vector<size_t> contracted_neighbors;
+        SearchBuffers witness;
+    };
+
+    struct Shortcut {
+        VertexId from;
+        VertexId to;
+        Weight weight;
+        size_t first;
+        size_t second;
+    };
+
+    void FindShortcuts(ContractionState& state, VertexId vertex, std::vector<Shortcut>& shortcuts) const;
+    std::ptrdiff_t ComputePriority(ContractionState& state, VertexId vertex, std::vector<Shortcut>& shortcuts) const;
+    void ContractVertex(ContractionState& state, VertexId vertex, std::vector<Shortcut>& shortcuts);
+    void BuildSearchGraphs(const std::vector<uint32_t>& ranks);
+    void UnpackEdge(size_t edge, std::vector<EdgeId>& edges) const;
+
+    static QueryBuffers& GetQueryBuffers() {
+        thread_local QueryBuffers buffers;
+        return buffers;
+    }
+
+    static constexpr Weight ZERO_WEIGHT{};
+    const Graph& graph_;
+    std::vector<HierarchyEdge> edges_;
+    // Рёбра к более важным вершинам, сгруппированные по начальной вершине
+    std::vector<size_t> up_offsets_;
+    std::vector<size_t> up_edges_;
+    // Рёбра от более важных вершин, сгруппированные по конечной вершине
+    std::vector<size_t> down_offsets_;
+    std::vector<size_t> down_edges_;
+};
+
+template <typename Weight>
+ContractionHierarchy<Weight>::ContractionHierarchy(const Graph& graph)
+    : graph_(graph)
+{
+    const size_t vertex_count = graph.GetVertexCount();
+    ContractionState state;
+    state.out_arcs.resize(vertex_count);
+    state.in_arcs.resize(vertex_count);
+    state.contracted.assign(vertex_count, false);
+    state.contracted_neighbors.assign(vertex_count, 0);
+
+    edges_.reserve(graph.GetEdgeCount());
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        const auto& edge = graph.GetEdge(edge_id);
+        if (edge.weight < ZERO_WEIGHT) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+        edges_.push_back(HierarchyEdge{edge.from, edge.to, edge.weight, edge_id, NO_EDGE, NO_EDGE});
+    }
+
+    // Из параллельных рёбер в поиске участвует только самое лёгкое
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
+            const auto& edge = edges_[edge_id];
+            if (edge.to == vertex) {
+                continue;
+            }
+            auto& arcs = state.out_arcs[vertex];
+            auto it = std::find_if(arcs.begin(), arcs.end(), [&edge](const Arc& arc) {
+                return arc.vertex == edge.to;
+            });
+            if (it == arcs.end()) {
+                arcs.push_back(Arc{edge.to, edge_id});
+            } else if (edge.weight < edges_[it->edge].weight) {
+                it->edge = edge_id;
+            }
+        }
+        for (const Arc& arc : state.out_arcs[vertex]) {
+            state.in_arcs[arc.vertex].push_back(Arc{vertex, arc.edge});
+        }
+    }
+
+    std::vector<Shortcut> shortcuts;
+    using PriorityItem = std::pair<std::ptrdiff_t, VertexId>;
+    std::priority_queue<PriorityItem, std::vector<PriorityItem>, std::greater<PriorityItem>> order;
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        order.emplace(ComputePriority(state, vertex, shortcuts), vertex);
+    }
+
+    std::vector<uint32_t> ranks(vertex_count);
+    uint32_t rank = 0;
+    while (!order.empty()) {
+        const VertexId vertex = order.top().second;
+        order.pop();
+
+        // Приоритеты соседей меняются при стягивании, поэтому пересчитываем их лениво
+        const std::ptrdiff_t priority = ComputePriority(state, vertex, shortcuts);
+        if (!order.empty() && priority > order.top().first) {
+            order.emplace(priority, vertex);
+            continue;
+        }
+
+        ContractVertex(state, vertex, shortcuts);
+        ranks[vertex] = rank++;
+    }
+
+    BuildSearchGraphs(ranks);
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::FindShortcuts(ContractionState& state, VertexId vertex,
+                                                 std::vector<Shortcut>& shortcuts) const {
+    shortcuts.clear();
+    auto& witness = state.witness;
+
+    for (const Arc& in_arc : state.in_arcs[vertex]) {
+        const VertexId source = in_arc.vertex;
+        if (state.contracted[source]) {
+            continue;
+        }
+        const Weight in_weight = edges_[in_arc.edge].weight;
+
+        Weight max_weight = ZERO_WEIGHT;
+        bool has_targets = false;
+        for (const Arc& out_arc : state.out_arcs[vertex]) {
+            if (!state.contracted[out_arc.vertex] && out_arc.vertex != source) {
+                max_weight = std::max(max_weight, in_weight + edges_[out_arc.edge].weight);
+                has_targets = true;
+            }
+        }
+        if (!has_targets) {
+            continue;
+        }
+
+        // Ищем пути-свидетели из source в обход стягиваемой вершины
+        witness.Prepare(state.out_arcs.size());
+        witness.Relax(source, ZERO_WEIGHT, NO_EDGE);
+        size_t settled = 0;
+        while (!witness.queue.empty() && settled < WITNESS_SETTLE_LIMIT) {
+            const auto [weight, current] = witness.Pop();
+            if (witness.weights[current] < weight) {
+                continue;
+            }
+            if (max_weight < weight) {
+                break;
+            }
+            ++settled;
+            for (const Arc& arc : state.out_arcs[current]) {
+                if (arc.vertex != vertex && !state.contracted[arc.vertex]) {
+                    witness.Relax(arc.vertex, weight + edges_[arc.edge].weight, arc.edge);
+                }
+            }
+        }
+
+        for (const Arc& out_arc : state.out_arcs[vertex]) {
+            const VertexId target = out_arc.vertex;
+            if (state.contracted[target] || target == source) {
+                continue;
+            }
+            const Weight weight = in_weight + edges_[out_arc.edge].weight;
+            if (!witness.IsReached(target) || weight < witness.weights[target]) {
+                shortcuts.push_back(Shortcut{source, target, weight, in_arc.edge, out_arc.edge});
+            }
+        }
+    }
+}
+
+template <typename Weight>
+std::ptrdiff_t ContractionHierarchy<Weight>::ComputePriority(ContractionState& state, VertexId vertex,
+                                                             std::vector<Shortcut>& shortcuts) const {
+    FindShortcuts(state, vertex, shortcuts);
+
+    std::ptrdiff_t removed_arcs = 0;
+    for (const Arc& arc : state.in_arcs[vertex]) {
+        removed_arcs += state.contracted[arc.vertex] ? 0 : 1;
+    }
+    for (const Arc& arc : state.out_arcs[vertex]) {
+        removed_arcs += state.contracted[arc.vertex] ? 0 : 1;
+    }
+
+    return static_cast<std::ptrdiff_t>(shortcuts.size()) - removed_arcs
+        + static_cast<std::ptrdiff_t>(state.contracted_neighbors[vertex]);
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::ContractVertex(ContractionState& state, VertexId vertex,
+                                                  std::vector<Shortcut>& shortcuts) {
+    FindShortcuts(state, vertex, shortcuts);
+
+    for (const Shortcut& shortcut : shortcuts) {
+        auto& arcs = state.out_arcs[shortcut.from];
+        auto it = std::find_if(arcs.begin(), arcs.end(), [&shortcut](const Arc& arc) {
+            return arc.vertex == shortcut.to;
+        });
+        if (it != arcs.end() && !(shortcut.weight < edges_[it->edge].weight)) {
+            continue;
+        }
+
+        const size_t edge = edges_.size();
+        edges_.push_back(HierarchyEdge{shortcut.from, shortcut.to, shortcut.weight, NO_EDGE,
+                                       shortcut.first, shortcut.second});
+        if (it != arcs.end()) {
+            it->edge = edge;
+            auto& in_arcs = state.in_arcs[shortcut.to];
+            std::find_if(in_arcs.begin(), in_arcs.end(), [&shortcut](const Arc& arc) {
+                return arc.vertex == shortcut.from;
+            })->edge = edge;
+        } else {
+            arcs.push_back(Arc{shortcut.to, edge});
+            state.in_arcs[shortcut.to].push_back(Arc{shortcut.from, edge});
+        }
+    }
+
+    state.contracted[vertex] = true;
+    for (const Arc& arc : state.in_arcs[vertex]) {
+        ++state.contracted_neighbors[arc.vertex];
+    }
+    for (const Arc& arc : state.out_arcs[vertex]) {
+        ++state.contracted_neighbors[arc.vertex];
+    }
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::BuildSearchGraphs(const std::vector<uint32_t>& ranks) {
+    const size_t vertex_count = ranks.size();
+    up_offsets_.assign(vertex_count + 1, 0);
+    down_offsets_.assign(vertex_count + 1, 0);
+
+    for (const HierarchyEdge& edge : edges_) {
+        if (edge.from == edge.to) {
+            continue;
+        }
+        if (ranks[edge.from] < ranks[edge.to]) {
+            ++up_offsets_[edge.from + 1];
+        } else {
+            ++down_offsets_[edge.to + 1];
+        }
+    }
+    for (size_t vertex = 0; vertex < vertex_count; ++vertex) {
+        up_offsets_[vertex + 1] += up_offsets_[vertex];
+        down_offsets_[vertex + 1] += down_offsets_[vertex];
+    }
+
+    up_edges_.resize(up_offsets_.back());
+    down_edges_.resize(down_offsets_.back());
+    std::vector<size_t> up_positions(up_offsets_.begin(), up_offsets_.end() - 1);
+    std::vector<size_t> down_positions(down_offsets_.begin(), down_offsets_.end() - 1);
+    for (size_t edge_id = 0; edge_id < edges_.size(); ++edge_id) {
+        const HierarchyEdge& edge = edges_[edge_id];
+        if (edge.from == edge.to) {
+            continue;
+        }
+        if (ranks[edge.from] < ranks[edge.to]) {
+            up_edges_[up_positions[edge.from]++] = edge_id;
+        } else {
+            down_edges_[down_positions[edge.to]++] = edge_id;
+        }
+    }
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::UnpackEdge(size_t edge, std::vector<EdgeId>& edges) const {
+    std::vector<size_t> stack{edge};
+    while (!stack.empty()) {
+        const HierarchyEdge& current = edges_[stack.back()];
+        stack.pop_back();
+        if (current.original_edge != NO_EDGE) {
+            edges.push_back(current.original_edge);
+        } else {
+            stack.push_back(current.second);
+            stack.push_back(current.first);
+        }
+    }
+}
+
+template <typename Weight>
+std::optional<typename ContractionHierarchy<Weight>::RouteInfo> ContractionHierarchy<Weight>::BuildRoute(
+    VertexId from, VertexId to) const
+{
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("Vertex is out of graph");
+    }
+
+    QueryBuffers& buffers = GetQueryBuffers();
+    SearchBuffers& forward = buffers.forward;
+    SearchBuffers& backward = buffers.backward;
+    forward.Prepare(vertex_count);
+    backward.Prepare(vertex_count);
+    forward.Relax(from, ZERO_WEIGHT, NO_EDGE);
+    backward.Relax(to, ZERO_WEIGHT, NO_EDGE);
+
+    std::optional<Weight> best_weight;
+    VertexId meeting_vertex = from;
+
+    // Поиск в направлении завершён, если его очередь пуста или не может улучшить найденный путь
+    const auto is_finished = [&best_weight](const SearchBuffers& search) {
+        return search.queue.empty() || (best_weight && !(search.queue.front().first < *best_weight));
+    };
+
+    while (!is_finished(forward) || !is_finished(backward)) {
+        const bool step_forward = is_finished(backward)
+            || (!is_finished(forward) && !(backward.queue.front().first < forward.queue.front().first));
+        SearchBuffers& search = step_forward ? forward : backward;
+        const SearchBuffers& opposite = step_forward ? backward : forward;
+
+        const auto [weight, vertex] = search.Pop();
+        if (search.weights[vertex] < weight) {
+            continue;
+        }
+        if (opposite.IsReached(vertex)) {
+            const Weight candidate_weight = weight + opposite.weights[vertex];
+            if (!best_weight || candidate_weight < *best_weight) {
+                best_weight = candidate_weight;
+                meeting_vertex = vertex;
+            }
+        }
+
+        if (step_forward) {
+            for (size_t i = up_offsets_[vertex]; i < up_offsets_[vertex + 1]; ++i) {
+                const HierarchyEdge& edge = edges_[up_edges_[i]];
+                search.Relax(edge.to, weight + edge.weight, up_edges_[i]);
+            }
+        } else {
+            for (size_t i = down_offsets_[vertex]; i < down_offsets_[vertex + 1]; ++i) {
+                const HierarchyEdge& edge = edges_[down_edges_[i]];
+                search.Relax(edge.from, weight + edge.weight, down_edges_[i]);
+            }
+        }
+    }
+
+    if (!best_weight) {
+        return std::nullopt;
+    }
+
+    std::vector<size_t> path;
+    for (size_t edge = forward.prev_edges[meeting_vertex]; edge != NO_EDGE;
+         edge = forward.prev_edges[edges_[edge].from])
+    {
+        path.push_back(edge);
+    }
+    std::reverse(path.begin(), path.end());
+    for (size_t edge = backward.prev_edges[meeting_vertex]; edge != NO_EDGE;
+         edge = backward.prev_edges[edges_[edge].to])
+    {
+        path.push_back(edge);
+    }
+
+    std::vector<EdgeId> edges;
+    for (const size_t edge : path) {
+        UnpackEdge(edge, edges);
+    }
+
+    return RouteInfo{*best_weight, std::move(edges)};
+}
+
+}  // namespace graph
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Маршрутизатор без предрасчёта: каждый запрос BuildRoute решается алгоритмом Дейкстры
+// от вершины from до вершины to. Рабочие массивы выделяются один раз на поток и
+// переиспользуются между запросами, поэтому BuildRoute можно вызывать из разных потоков.
+template <typename Weight>
+class DijkstraRouter {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    using RouteInfo = typename Router<Weight>::RouteInfo;
+
+    explicit DijkstraRouter(const Graph& graph);
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+
+    const Graph& GetGraph() const {
+        return graph_;
+    }
+
+private:
+    using QueueItem = std::pair<Weight, VertexId>;
+
+    // Массивы одного потока. Вершина считается достигнутой в текущем запросе, только если её
+    // метка совпадает с stamp, поэтому между запросами массивы не очищаются.
+    struct ScratchBuffers {
+        std::vector<Weight> weights;
+        std::vector<EdgeId> prev_edges;
+        std::vector<uint32_t> stamps;
+        std::vector<QueueItem> queue;
+        uint32_t stamp = 0;
+
+        void Prepare(size_t vertex_count) {
+            if (stamps.size() < vertex_count) {
+                weights.resize(vertex_count);
+                prev_edges.resize(vertex_count);
+                stamps.resize(vertex_count, 0);
+            }
+            if (++stamp == 0) {
+                std::fill(stamps.begin(), stamps.end(), 0);
+                stamp = 1;
+            }
+            queue.clear();
+        }
+
+        bool IsReached(VertexId vertex) const {
+            return stamps[vertex] == stamp;
+        }
+    };
+
+    static ScratchBuffers& GetScratchBuffers() {
+        thread_local ScratchBuffers buffers;
+        return buffers;
+    }
+
+    static constexpr Weight ZERO_WEIGHT{};
+    static constexpr EdgeId NO_EDGE = std::numeric_limits<EdgeId>::max();
+    const Graph& graph_;
+};
+
+template <typename Weight>
+DijkstraRouter<Weight>::DijkstraRouter(const Graph& graph)
+    : graph_(graph)
+{
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        if (graph.GetEdge(edge_id).weight < ZERO_WEIGHT) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+    }
+}
+
+template <typename Weight>
+std::optional<typename DijkstraRouter<Weight>::RouteInfo> DijkstraRouter<Weight>::BuildRoute(VertexId from,
+                                                                                             VertexId to) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("Vertex is out of graph");
+    }
+
+    ScratchBuffers& buffers = GetScratchBuffers();
+    buffers.Prepare(vertex_count);
+
+    auto& queue = buffers.queue;
+    const auto queue_order = std::greater<QueueItem>{};
+
+    buffers.stamps[from] = buffers.stamp;
+    buffers.weights[from] = ZERO_WEIGHT;
+    buffers.prev_edges[from] = NO_EDGE;
+    queue.emplace_back(ZERO_WEIGHT, from);
+
+    while (!queue.empty()) {
+        std::pop_heap(queue.begin(), queue.end(), queue_order);
+        const auto [weight, vertex] = queue.back();
+        queue.pop_back();
+
+        if (buffers.weights[vertex] < weight) {
+            continue;
+        }
+        if (vertex == to) {
+            break;
+        }
+
+        for (const EdgeId edge_id : graph_.GetIncidentEdges(vertex)) {
+            const auto& edge = graph_.GetEdge(edge_id);
+            const Weight candidate_weight = weight + edge.weight;
+            if (!buffers.IsReached(edge.to) || candidate_weight < buffers.weights[edge.to]) {
+                buffers.stamps[edge.to] = buffers.stamp;
+                buffers.weights[edge.to] = candidate_weight;
+                buffers.prev_edges[edge.to] = edge_id;
+                queue.emplace_back(candidate_weight, edge.to);
+                std::push_heap(queue.begin(), queue.end(), queue_order);
+            }
+        }
+    }
+
+    if (!buffers.IsReached(to)) {
+        return std::nullopt;
+    }
+
+    std::vector<EdgeId> edges;
+    for (EdgeId edge_id = buffers.prev_edges[to]; edge_id != NO_EDGE;
+         edge_id = buffers.prev_edges[graph_.GetEdge(edge_id).from])
+    {
+        edges.push_back(edge_id);
+    }
+    std::reverse(edges.begin(), edges.end());
+
+    return RouteInfo{buffers.weights[to], std::move(edges)};
+}
+
+}  // namespace graph
@@ -0,0 +1,68 @@
+#include "distance_table.h"
+
+namespace transport_catalogue {
+
+    namespace {
+        // Финализатор splitmix64: перемешивает все биты ключа, поэтому соседние номера
+        // остановок не попадают в соседние ячейки
+        uint64_t MixKey(uint64_t key) {
+            key ^= key >> 30;
+            key *= 0xbf58476d1ce4e5b9ULL;
+            key ^= key >> 27;
+            key *= 0x94d049bb133111ebULL;
+            key ^= key >> 31;
+            return key;
+        }
+    }
+
+    size_t DistanceTable::FindSlot(uint64_t key) const {
+        const size_t mask = entries_.size() - 1;
+        size_t slot = static_cast<size_t>(MixKey(key)) & mask;
+        while (entries_[slot].key != key && entries_[slot].key != EMPTY_KEY) {
+            slot = (slot + 1) & mask;
+        }
+        return slot;
+    }
+
+    void DistanceTable::Grow() {
+        std::vector<Entry> old_entries(entries_.empty() ? 16 : entries_.size() * 2, Entry{EMPTY_KEY, 0.0});
+        entries_.swap(old_entries);
+        for (const Entry& entry : old_entries) {
+            if (entry.key != EMPTY_KEY) {
+                entries_[FindSlot(entry.key)] = entry;
+            }
+        }
+    }
+
+    void DistanceTable::Set(domain::StopId from, domain::StopId to, double distance) {
+        // Заполненность таблицы держим не выше половины, чтобы цепочки проб были короткими
+        if (2 * (size_ + 1) > entries_.size()) {
+            Grow();
+        }
+        const uint64_t key = MakeKey(from, to);
+        Entry& entry = entries_[FindSlot(key)];
+        if (entry.key == EMPTY_KEY) {
+            entry = Entry{key, distance};
+            ++size_;
+        }
+    }
+
+    std::optional<double> DistanceTable::Find(domain::StopId from, domain::StopId to) const {
+        if (entries_.empty()) {
+            return std::nullopt;
+        }
+        const Entry& entry = entries_[FindSlot(MakeKey(from, to))];
+        if (entry.key == EMPTY_KEY) {
+            return std::nullopt;
+        }
+        return entry.distance;
+    }
+
+    double DistanceTable::Get(domain::StopId from, domain::StopId to) const {
+        if (const auto distance = Find(from, to)) {
+            return *distance;
+        }
+        return Find(to, from).value_or(0.0);
+    }
+
+};
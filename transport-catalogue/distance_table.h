@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "domain.h"
+
+namespace transport_catalogue {
+
+    // Таблица дорожных расстояний между остановками с открытой адресацией.
+    // Ключ — пара номеров остановок, упакованная в одно 64-битное число, поэтому поиск
+    // это один хеш и линейный проход по соседним ячейкам одного массива
+    class DistanceTable {
+    public:
+        struct Entry {
+            uint64_t key;
+            double distance;
+        };
+
+        // Запоминает расстояние from -> to, если оно ещё не задано
+        void Set(domain::StopId from, domain::StopId to, double distance);
+
+        // Расстояние строго в направлении from -> to
+        std::optional<double> Find(domain::StopId from, domain::StopId to) const;
+
+        // Расстояние from -> to, а если оно не задано — to -> from; 0, если нет обоих
+        double Get(domain::StopId from, domain::StopId to) const;
+
+        size_t Size() const {
+            return size_;
+        }
+
+        // Вызывает func(from, to, distance) для каждого заданного расстояния
+        template <typename Func>
+        void ForEach(Func func) const {
+            for (const Entry& entry : entries_) {
+                if (entry.key != EMPTY_KEY) {
+                    func(static_cast<domain::StopId>(entry.key >> 32), static_cast<domain::StopId>(entry.key),
+                         entry.distance);
+                }
+            }
+        }
+
+    private:
+        static constexpr uint64_t EMPTY_KEY = ~uint64_t{0};
+
+        static uint64_t MakeKey(domain::StopId from, domain::StopId to) {
+            return (uint64_t{from} << 32) | to;
+        }
+
+        size_t FindSlot(uint64_t key) const;
+        void Grow();
+
+        std::vector<Entry> entries_;
+        size_t size_ = 0;
+    };
+
+};
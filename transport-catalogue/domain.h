@@ -1,7 +1,9 @@
 #pragma once
 
+#include <cstdint>
 #include <set>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "geo.h"
@@ -19,9 +21,14 @@
 
 namespace domain {
 
+// Плотные номера остановок и маршрутов: присваиваются по порядку добавления в справочник
+using StopId = uint32_t;
+using BusId = uint32_t;
+
+// Названия остановок и маршрутов принадлежат справочнику (TransportCatalogue::InternName)
 struct Stop {
-    size_t id;
-    std::string name;
+    StopId id;
+    std::string_view name;
     geo::Coordinates coordinates;
 
     bool operator==(const Stop& other) const {
@@ -33,10 +40,11 @@ struct Stop {
 };
 
 struct Bus {
-    std::string name_;
+    std::string_view name_;
     std::vector<Stop*> stops_;
-    bool is_roundtrip_;
-    Stop* end_stop_;
+    bool is_roundtrip_ = false;
+    Stop* end_stop_ = nullptr;
+    BusId id_ = 0;
 
     bool operator==(const Bus& other) const {
         return stops_ == other.stops_ && name_ == other.name_;
@@ -167,6 +167,8 @@ namespace transport_catalogue {
                     catalogue.AddBus(std::string(Trim(cmd.id)), ParseRoute(cmd.description));
                 }
             }
+
+            catalogue.Finalize();
         }
 
         void ReadFromStream(std::istream& input, TransportCatalogue& catalogue) {
@@ -1,240 +1,474 @@
 #include "json.h"
 
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <iterator>
+#include <system_error>
+
+#include "mapped_file.h"
 
 namespace json {
 
 namespace {
 using namespace std::literals;
 
-Node LoadNode(std::istream& input);
-Node LoadString(std::istream& input);
+bool IsSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
 
-std::string LoadLiteral(std::istream& input) {
-    std::string s;
-    while (std::isalpha(input.peek())) {
-        s.push_back(static_cast<char>(input.get()));
-    }
-    return s;
+bool IsDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+bool IsAlpha(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
 }
 
-Node LoadArray(std::istream& input) {
-    std::vector<Node> result;
+// Находит первый из символов Stops. Входные данные просматриваются словами по 8 байт,
+// и только слово с подходящим байтом досматривается посимвольно
+template <char... Stops>
+const char* FindFirstOf(const char* pos, const char* end) {
+    constexpr uint64_t ONES = 0x0101010101010101ULL;
+    constexpr uint64_t HIGHS = 0x8080808080808080ULL;
+    const auto has_byte = [](uint64_t word, unsigned char byte) {
+        const uint64_t x = word ^ (ONES * byte);
+        return (x - ONES) & ~x & HIGHS;
+    };
 
-    for (char c; input >> c && c != ']';) {
-        if (c != ',') {
-            input.putback(c);
+    while (end - pos >= 8) {
+        uint64_t word;
+        std::memcpy(&word, pos, sizeof(word));
+        if ((has_byte(word, static_cast<unsigned char>(Stops)) | ...)) {
+            break;
         }
-        result.push_back(LoadNode(input));
+        pos += 8;
     }
-    if (!input) {
-        throw ParsingError("Array parsing error"s);
+    while (pos != end && ((*pos != Stops) && ...)) {
+        ++pos;
     }
-    return Node(std::move(result));
+    return pos;
 }
 
-Node LoadDict(std::istream& input) {
-    Dict dict;
+// Символ, на котором нужно прервать копирование строки при разборе: кавычка, обратная
+// косая черта или перевод строки
+const char* FindStringStop(const char* pos, const char* end) {
+    return FindFirstOf<'"', '\\', '\n', '\r'>(pos, end);
+}
 
-    for (char c; input >> c && c != '}';) {
-        if (c == '"') {
-            std::string key = LoadString(input).AsString();
-            if (input >> c && c == ':') {
-                if (dict.find(key) != dict.end()) {
-                    throw ParsingError("Duplicate key '"s + key + "' have been found");
-                }
-                dict.emplace(std::move(key), LoadNode(input));
-            } else {
-                throw ParsingError(": is expected but '"s + c + "' has been found"s);
-            }
-        } else if (c != ',') {
-            throw ParsingError(R"(',' is expected but ')"s + c + "' has been found"s);
+// Символ, который нужно экранировать при выводе строки
+const char* FindEscapeStop(const char* pos, const char* end) {
+    return FindFirstOf<'"', '\\', '\n', '\r', '\t'>(pos, end);
+}
+
+// Дописывает value с экранированием, без кавычек. Участки без специальных символов
+// копируются целиком
+void AppendEscaped(std::string& out, const char* pos, const char* end) {
+    while (true) {
+        const char* stop = FindEscapeStop(pos, end);
+        out.append(pos, stop);
+        if (stop == end) {
+            return;
         }
+        switch (*stop) {
+            case '\r':
+                out += "\\r"sv;
+                break;
+            case '\n':
+                out += "\\n"sv;
+                break;
+            case '\t':
+                out += "\\t"sv;
+                break;
+            default:
+                // Символы " и \ выводятся как \" или \\, соответственно
+                out.push_back('\\');
+                out.push_back(*stop);
+                break;
+        }
+        pos = stop + 1;
     }
-    if (!input) {
-        throw ParsingError("Dictionary parsing error"s);
-    }
-    return Node(std::move(dict));
 }
 
-Node LoadString(std::istream& input) {
-    auto it = std::istreambuf_iterator<char>(input);
-    auto end = std::istreambuf_iterator<char>();
-    std::string s;
-    while (true) {
-        if (it == end) {
-            throw ParsingError("String parsing error");
+// Лексический разбор JSON из непрерывного буфера в памяти: вместо чтения потока посимвольно
+// парсер двигает указатель по буферу. Общий для построения дерева и для потокового разбора
+class Scanner {
+public:
+    explicit Scanner(std::string_view input)
+        : pos_(input.data())
+        , end_(input.data() + input.size()) {
+    }
+
+protected:
+    // Пропускает пробельные символы и считывает очередной символ
+    bool NextToken(char& c) {
+        while (pos_ != end_ && IsSpace(*pos_)) {
+            ++pos_;
         }
-        const char ch = *it;
-        if (ch == '"') {
-            ++it;
-            break;
-        } else if (ch == '\\') {
-            ++it;
-            if (it == end) {
+        if (pos_ == end_) {
+            return false;
+        }
+        c = *pos_++;
+        return true;
+    }
+
+    int Peek() const {
+        return pos_ == end_ ? EOF : static_cast<unsigned char>(*pos_);
+    }
+
+    std::string_view LoadLiteral() {
+        const char* begin = pos_;
+        while (pos_ != end_ && IsAlpha(*pos_)) {
+            ++pos_;
+        }
+        return {begin, static_cast<size_t>(pos_ - begin)};
+    }
+
+    // Строка без escape-последовательностей возвращается представлением прямо во входной
+    // буфер, иначе она собирается в buffer_. Результат действителен до следующего вызова
+    std::string_view LoadString() {
+        const char* stop = FindStringStop(pos_, end_);
+        if (stop != end_ && *stop == '"') {
+            const std::string_view result(pos_, static_cast<size_t>(stop - pos_));
+            pos_ = stop + 1;
+            return result;
+        }
+
+        std::string& s = buffer_;
+        s.clear();
+        while (true) {
+            stop = FindStringStop(pos_, end_);
+            s.append(pos_, stop);
+            pos_ = stop;
+            if (pos_ == end_) {
                 throw ParsingError("String parsing error");
             }
-            const char escaped_char = *(it);
-            switch (escaped_char) {
-                case 'n':
-                    s.push_back('\n');
-                    break;
-                case 't':
-                    s.push_back('\t');
-                    break;
-                case 'r':
-                    s.push_back('\r');
-                    break;
-                case '"':
-                    s.push_back('"');
-                    break;
-                case '\\':
-                    s.push_back('\\');
-                    break;
-                default:
-                    throw ParsingError("Unrecognized escape sequence \\"s + escaped_char);
+            const char ch = *pos_++;
+            if (ch == '"') {
+                break;
+            } else if (ch == '\\') {
+                if (pos_ == end_) {
+                    throw ParsingError("String parsing error");
+                }
+                const char escaped_char = *pos_++;
+                switch (escaped_char) {
+                    case 'n':
+                        s.push_back('\n');
+                        break;
+                    case 't':
+                        s.push_back('\t');
+                        break;
+                    case 'r':
+                        s.push_back('\r');
+                        break;
+                    case '"':
+                        s.push_back('"');
+                        break;
+                    case '\\':
+                        s.push_back('\\');
+                        break;
+                    default:
+                        throw ParsingError("Unrecognized escape sequence \\"s + escaped_char);
+                }
+            } else {
+                throw ParsingError("Unexpected end of line"s);
             }
-        } else if (ch == '\n' || ch == '\r') {
-            throw ParsingError("Unexpected end of line"s);
-        } else {
-            s.push_back(ch);
         }
-        ++it;
-    }
 
-    return Node(std::move(s));
-}
+        return s;
+    }
 
-Node LoadBool(std::istream& input) {
-    const auto s = LoadLiteral(input);
-    if (s == "true"sv) {
-        return Node{true};
-    } else if (s == "false"sv) {
-        return Node{false};
-    } else {
-        throw ParsingError("Failed to parse '"s + s + "' as bool"s);
+    bool LoadBool() {
+        const auto s = LoadLiteral();
+        if (s == "true"sv) {
+            return true;
+        } else if (s == "false"sv) {
+            return false;
+        } else {
+            throw ParsingError("Failed to parse '"s + std::string(s) + "' as bool"s);
+        }
     }
-}
 
-Node LoadNull(std::istream& input) {
-    if (auto literal = LoadLiteral(input); literal == "null"sv) {
-        return Node{nullptr};
-    } else {
-        throw ParsingError("Failed to parse '"s + literal + "' as null"s);
+    void LoadNull() {
+        if (auto literal = LoadLiteral(); literal != "null"sv) {
+            throw ParsingError("Failed to parse '"s + std::string(literal) + "' as null"s);
+        }
     }
-}
 
-Node LoadNumber(std::istream& input) {
-    std::string parsed_num;
+    Node LoadNumber() {
+        const char* begin = pos_;
+
+        // Считывает одну или более цифр
+        auto read_digits = [this] {
+            if (!IsDigit(static_cast<char>(Peek()))) {
+                throw ParsingError("A digit is expected"s);
+            }
+            while (IsDigit(static_cast<char>(Peek()))) {
+                ++pos_;
+            }
+        };
 
-    // Считывает в parsed_num очередной символ из input
-    auto read_char = [&parsed_num, &input] {
-        parsed_num += static_cast<char>(input.get());
-        if (!input) {
-            throw ParsingError("Failed to read number from stream"s);
+        if (Peek() == '-') {
+            ++pos_;
+        }
+        // Парсим целую часть числа
+        if (Peek() == '0') {
+            ++pos_;
+            // После 0 в JSON не могут идти другие цифры
+        } else {
+            read_digits();
         }
-    };
 
-    // Считывает одну или более цифр в parsed_num из input
-    auto read_digits = [&input, read_char] {
-        if (!std::isdigit(input.peek())) {
-            throw ParsingError("A digit is expected"s);
+        bool is_int = true;
+        // Парсим дробную часть числа
+        if (Peek() == '.') {
+            ++pos_;
+            read_digits();
+            is_int = false;
         }
-        while (std::isdigit(input.peek())) {
-            read_char();
+
+        // Парсим экспоненциальную часть числа
+        if (int ch = Peek(); ch == 'e' || ch == 'E') {
+            ++pos_;
+            if (ch = Peek(); ch == '+' || ch == '-') {
+                ++pos_;
+            }
+            read_digits();
+            is_int = false;
         }
-    };
 
-    if (input.peek() == '-') {
-        read_char();
+        if (is_int) {
+            // Сначала пробуем преобразовать строку в int, при переполнении —
+            // код ниже попробует преобразовать строку в double
+            int value;
+            if (const auto [ptr, ec] = std::from_chars(begin, pos_, value); ec == std::errc() && ptr == pos_) {
+                return value;
+            }
+        }
+        double value;
+        if (const auto [ptr, ec] = std::from_chars(begin, pos_, value); ec == std::errc() && ptr == pos_) {
+            return value;
+        }
+        throw ParsingError("Failed to convert "s + std::string(begin, pos_) + " to number"s);
     }
-    // Парсим целую часть числа
-    if (input.peek() == '0') {
-        read_char();
-        // После 0 в JSON не могут идти другие цифры
-    } else {
-        read_digits();
+
+    const char* pos_;
+    const char* end_;
+
+private:
+    std::string buffer_;
+};
+
+// Разбор JSON в дерево Node
+class Parser : private Scanner {
+public:
+    using Scanner::Scanner;
+
+    Node LoadNode() {
+        char c;
+        if (!NextToken(c)) {
+            throw ParsingError("Unexpected EOF"s);
+        }
+        switch (c) {
+            case '[':
+                return LoadArray();
+            case '{':
+                return LoadDict();
+            case '"':
+                return Node(std::string(LoadString()));
+            case 't':
+                // Встретив t или f, переходим к попытке парсинга литералов true либо false
+                [[fallthrough]];
+            case 'f':
+                --pos_;
+                return Node{LoadBool()};
+            case 'n':
+                --pos_;
+                LoadNull();
+                return Node{nullptr};
+            default:
+                --pos_;
+                return LoadNumber();
+        }
     }
 
-    bool is_int = true;
-    // Парсим дробную часть числа
-    if (input.peek() == '.') {
-        read_char();
-        read_digits();
-        is_int = false;
+private:
+    Node LoadArray() {
+        std::vector<Node> result;
+
+        char c;
+        bool closed = false;
+        while (NextToken(c)) {
+            if (c == ']') {
+                closed = true;
+                break;
+            }
+            if (c != ',') {
+                --pos_;
+            }
+            result.push_back(LoadNode());
+        }
+        if (!closed) {
+            throw ParsingError("Array parsing error"s);
+        }
+        return Node(std::move(result));
     }
 
-    // Парсим экспоненциальную часть числа
-    if (int ch = input.peek(); ch == 'e' || ch == 'E') {
-        read_char();
-        if (ch = input.peek(); ch == '+' || ch == '-') {
-            read_char();
+    Node LoadDict() {
+        Dict dict;
+
+        char c;
+        bool closed = false;
+        while (NextToken(c)) {
+            if (c == '}') {
+                closed = true;
+                break;
+            }
+            if (c == '"') {
+                std::string key(LoadString());
+                if (NextToken(c) && c == ':') {
+                    if (dict.find(key) != dict.end()) {
+                        throw ParsingError("Duplicate key '"s + key + "' have been found");
+                    }
+                    dict.emplace(std::move(key), LoadNode());
+                } else {
+                    throw ParsingError(": is expected but '"s + c + "' has been found"s);
+                }
+            } else if (c != ',') {
+                throw ParsingError(R"(',' is expected but ')"s + c + "' has been found"s);
+            }
         }
-        read_digits();
-        is_int = false;
+        if (!closed) {
+            throw ParsingError("Dictionary parsing error"s);
+        }
+        return Node(std::move(dict));
     }
+};
 
-    try {
-        if (is_int) {
-            // Сначала пробуем преобразовать строку в int
-            try {
-                return std::stoi(parsed_num);
-            } catch (...) {
-                // В случае неудачи, например, при переполнении
-                // код ниже попробует преобразовать строку в double
+// Потоковый разбор: та же грамматика, что и у Parser, но вместо построения узлов
+// вызываются методы обработчика
+class EventParser : private Scanner {
+public:
+    EventParser(std::string_view input, Handler& handler)
+        : Scanner(input)
+        , handler_(handler) {
+    }
+
+    void ParseNode() {
+        char c;
+        if (!NextToken(c)) {
+            throw ParsingError("Unexpected EOF"s);
+        }
+        switch (c) {
+            case '[':
+                ParseArray();
+                break;
+            case '{':
+                ParseDict();
+                break;
+            case '"':
+                handler_.OnString(LoadString());
+                break;
+            case 't':
+                [[fallthrough]];
+            case 'f':
+                --pos_;
+                handler_.OnBool(LoadBool());
+                break;
+            case 'n':
+                --pos_;
+                LoadNull();
+                handler_.OnNull();
+                break;
+            default: {
+                --pos_;
+                const Node number = LoadNumber();
+                if (number.IsInt()) {
+                    handler_.OnInt(number.AsInt());
+                } else {
+                    handler_.OnDouble(number.AsDouble());
+                }
             }
         }
-        return std::stod(parsed_num);
-    } catch (...) {
-        throw ParsingError("Failed to convert "s + parsed_num + " to number"s);
     }
-}
 
-Node LoadNode(std::istream& input) {
-    char c;
-    if (!(input >> c)) {
-        throw ParsingError("Unexpected EOF"s);
+private:
+    void ParseArray() {
+        handler_.OnStartArray();
+
+        char c;
+        bool closed = false;
+        while (NextToken(c)) {
+            if (c == ']') {
+                closed = true;
+                break;
+            }
+            if (c != ',') {
+                --pos_;
+            }
+            ParseNode();
+        }
+        if (!closed) {
+            throw ParsingError("Array parsing error"s);
+        }
+        handler_.OnEndArray();
     }
-    switch (c) {
-        case '[':
-            return LoadArray(input);
-        case '{':
-            return LoadDict(input);
-        case '"':
-            return LoadString(input);
-        case 't':
-            // Атрибут [[fallthrough]] (провалиться) ничего не делает, и является
-            // подсказкой компилятору и человеку, что здесь программист явно задумывал
-            // разрешить переход к инструкции следующей ветки case, а не случайно забыл
-            // написать break, return или throw.
-            // В данном случае, встретив t или f, переходим к попытке парсинга
-            // литералов true либо false
-            [[fallthrough]];
-        case 'f':
-            input.putback(c);
-            return LoadBool(input);
-        case 'n':
-            input.putback(c);
-            return LoadNull(input);
-        default:
-            input.putback(c);
-            return LoadNumber(input);
+
+    void ParseDict() {
+        handler_.OnStartDict();
+
+        char c;
+        bool closed = false;
+        while (NextToken(c)) {
+            if (c == '}') {
+                closed = true;
+                break;
+            }
+            if (c == '"') {
+                handler_.OnKey(LoadString());
+                if (NextToken(c) && c == ':') {
+                    ParseNode();
+                } else {
+                    throw ParsingError(": is expected but '"s + c + "' has been found"s);
+                }
+            } else if (c != ',') {
+                throw ParsingError(R"(',' is expected but ')"s + c + "' has been found"s);
+            }
+        }
+        if (!closed) {
+            throw ParsingError("Dictionary parsing error"s);
+        }
+        handler_.OnEndDict();
     }
-}
+
+    Handler& handler_;
+};
 
 struct PrintContext {
     std::ostream& out;
+    number_format::Precision numbers;
+    bool compact = false;
     int indent_step = 4;
     int indent = 0;
 
     void PrintIndent() const {
+        if (compact) {
+            return;
+        }
         for (int i = 0; i < indent; ++i) {
             out.put(' ');
         }
     }
 
+    void PrintNewLine() const {
+        if (!compact) {
+            out.put('\n');
+        }
+    }
+
     PrintContext Indented() const {
-        return {out, indent_step, indent_step + indent};
+        return {out, numbers, compact, indent_step, indent_step + indent};
     }
 };
 
@@ -277,6 +511,16 @@ void PrintValue<std::string>(const std::string& value, const PrintContext& ctx)
     PrintString(value, ctx.out);
 }
 
+template <>
+void PrintValue<int>(const int& value, const PrintContext& ctx) {
+    number_format::Write(ctx.out, value);
+}
+
+template <>
+void PrintValue<double>(const double& value, const PrintContext& ctx) {
+    number_format::Write(ctx.out, value, ctx.numbers);
+}
+
 template <>
 void PrintValue<std::nullptr_t>(const std::nullptr_t&, const PrintContext& ctx) {
     ctx.out << "null"sv;
@@ -294,19 +538,21 @@ void PrintValue<bool>(const bool& value, const PrintContext& ctx) {
 template <>
 void PrintValue<Array>(const Array& nodes, const PrintContext& ctx) {
     std::ostream& out = ctx.out;
-    out << "[\n"sv;
+    out.put('[');
+    ctx.PrintNewLine();
     bool first = true;
     auto inner_ctx = ctx.Indented();
     for (const Node& node : nodes) {
         if (first) {
             first = false;
         } else {
-            out << ",\n"sv;
+            out.put(',');
+            ctx.PrintNewLine();
         }
         inner_ctx.PrintIndent();
         PrintNode(node, inner_ctx);
     }
-    out.put('\n');
+    ctx.PrintNewLine();
     ctx.PrintIndent();
     out.put(']');
 }
@@ -314,21 +560,23 @@ void PrintValue<Array>(const Array& nodes, const PrintContext& ctx) {
 template <>
 void PrintValue<Dict>(const Dict& nodes, const PrintContext& ctx) {
     std::ostream& out = ctx.out;
-    out << "{\n"sv;
+    out.put('{');
+    ctx.PrintNewLine();
     bool first = true;
     auto inner_ctx = ctx.Indented();
     for (const auto& [key, node] : nodes) {
         if (first) {
             first = false;
         } else {
-            out << ",\n"sv;
+            out.put(',');
+            ctx.PrintNewLine();
         }
         inner_ctx.PrintIndent();
         PrintString(key, ctx.out);
-        out << ": "sv;
+        out << (ctx.compact ? ":"sv : ": "sv);
         PrintNode(node, inner_ctx);
     }
-    out.put('\n');
+    ctx.PrintNewLine();
     ctx.PrintIndent();
     out.put('}');
 }
@@ -344,11 +592,48 @@ void PrintNode(const Node& node, const PrintContext& ctx) {
 }  // namespace
 
 Document Load(std::istream& input) {
-    return Document{LoadNode(input)};
+    const std::string buffer{std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>()};
+    return Load(std::string_view(buffer));
+}
+
+Document Load(std::string_view input) {
+    return Document{Parser(input).LoadNode()};
+}
+
+Document LoadFile(const std::string& path) {
+    const io::MappedFile file(path);
+    return Load(file.GetData());
+}
+
+void Parse(std::string_view input, Handler& handler) {
+    EventParser(input, handler).ParseNode();
+}
+
+void AppendString(std::string& out, std::string_view value) {
+    out.push_back('"');
+    AppendEscaped(out, value.data(), value.data() + value.size());
+    out.push_back('"');
+}
+
+EscapingStreambuf::EscapingStreambuf(std::string& target)
+    : target_(target) {
+}
+
+std::streamsize EscapingStreambuf::xsputn(const char* data, std::streamsize count) {
+    AppendEscaped(target_, data, data + count);
+    return count;
+}
+
+EscapingStreambuf::int_type EscapingStreambuf::overflow(int_type ch) {
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        const char c = traits_type::to_char_type(ch);
+        AppendEscaped(target_, &c, &c + 1);
+    }
+    return traits_type::not_eof(ch);
 }
 
-void Print(const Document& doc, std::ostream& output) {
-    PrintNode(doc.GetRoot(), PrintContext{output});
+void Print(const Document& doc, std::ostream& output, const PrintOptions& options) {
+    PrintNode(doc.GetRoot(), PrintContext{output, options.numbers, options.compact});
 }
 
 }  // namespace json
\ No newline at end of file
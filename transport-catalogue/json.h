@@ -2,10 +2,14 @@
 
 #include <iostream>
 #include <map>
+#include <streambuf>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 
+#include "number_format.h"
+
 namespace json {
 
 class Node;
@@ -140,8 +144,60 @@ inline bool operator!=(const Document& lhs, const Document& rhs) {
     return !(lhs == rhs);
 }
 
+// Получатель событий потокового разбора (SAX): вместо дерева Node парсер сообщает о каждом
+// значении по мере чтения. Строки и ключи передаются представлениями, которые действительны
+// только до возврата из обработчика
+class Handler {
+public:
+    virtual void OnNull() = 0;
+    virtual void OnBool(bool value) = 0;
+    virtual void OnInt(int value) = 0;
+    virtual void OnDouble(double value) = 0;
+    virtual void OnString(std::string_view value) = 0;
+    virtual void OnKey(std::string_view key) = 0;
+    virtual void OnStartDict() = 0;
+    virtual void OnEndDict() = 0;
+    virtual void OnStartArray() = 0;
+    virtual void OnEndArray() = 0;
+
+protected:
+    ~Handler() = default;
+};
+
 Document Load(std::istream& input);
+// Разбирает JSON из непрерывного буфера; результат совпадает с Load(std::istream&)
+Document Load(std::string_view input);
+// Отображает файл в память и разбирает его без промежуточного копирования
+Document LoadFile(const std::string& path);
+// Разбирает JSON без построения дерева, передавая события обработчику. Повторяющиеся ключи
+// словаря не проверяются: это оставлено обработчику
+void Parse(std::string_view input, Handler& handler);
+
+// Настройки вывода JSON
+struct PrintOptions {
+    number_format::Precision numbers;
+    // Компактный вывод: без отступов и переводов строк
+    bool compact = false;
+};
+
+void Print(const Document& doc, std::ostream& output, const PrintOptions& options = {});
 
-void Print(const Document& doc, std::ostream& output);
+// Дописывает к out строку value в кавычках и с экранированием, так же как её выводит Print
+void AppendString(std::string& out, std::string_view value);
+
+// Буфер потока, который дописывает всё выведенное в него к target с экранированием
+// строки JSON (без кавычек). Позволяет выводить большой текст, например SVG, сразу
+// в содержимое строки JSON без промежуточной копии
+class EscapingStreambuf final : public std::streambuf {
+public:
+    explicit EscapingStreambuf(std::string& target);
+
+protected:
+    std::streamsize xsputn(const char* data, std::streamsize count) override;
+    int_type overflow(int_type ch) override;
+
+private:
+    std::string& target_;
+};
 
 }  // namespace json
\ No newline at end of file
@@ -0,0 +1,189 @@
+#include "json_compact.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <variant>
+
+using namespace std::literals;
+
+namespace json {
+namespace compact {
+
+std::string_view Arena::CopyString(std::string_view value) {
+    if (value.empty()) {
+        return {};
+    }
+    char* data = AllocateArray<char>(value.size());
+    std::memcpy(data, value.data(), value.size());
+    return {data, value.size()};
+}
+
+void* Arena::Allocate(size_t size, size_t alignment) {
+    size_t padding = pos_ == nullptr ? 0 : (alignment - reinterpret_cast<uintptr_t>(pos_) % alignment) % alignment;
+    if (pos_ == nullptr || padding + size > available_) {
+        // Крупные массивы получают отдельный блок, чтобы не оставлять в арене пустых хвостов
+        const size_t block_size = std::max(size + alignment, BLOCK_SIZE);
+        blocks_.push_back(std::make_unique<char[]>(block_size));
+        pos_ = blocks_.back().get();
+        available_ = block_size;
+        padding = (alignment - reinterpret_cast<uintptr_t>(pos_) % alignment) % alignment;
+    }
+    char* result = pos_ + padding;
+    pos_ = result + size;
+    available_ -= padding + size;
+    return result;
+}
+
+const Value* DictView::find(std::string_view key) const {
+    const Member* it = std::lower_bound(begin(), end(), key, [](const Member& member, std::string_view key) {
+        return member.key < key;
+    });
+    return it != end() && it->key == key ? &it->value : nullptr;
+}
+
+const Value& DictView::at(std::string_view key) const {
+    if (const Value* value = find(key)) {
+        return *value;
+    }
+    throw std::out_of_range("Key '"s + std::string(key) + "' is not found"s);
+}
+
+void DocumentBuilder::OnNull() {
+    AddValue(Value::Null());
+}
+
+void DocumentBuilder::OnBool(bool value) {
+    AddValue(Value::Bool(value));
+}
+
+void DocumentBuilder::OnInt(int value) {
+    AddValue(Value::Int(value));
+}
+
+void DocumentBuilder::OnDouble(double value) {
+    AddValue(Value::Double(value));
+}
+
+void DocumentBuilder::OnString(std::string_view value) {
+    AddValue(Value::String(StoreString(value)));
+}
+
+void DocumentBuilder::OnKey(std::string_view key) {
+    members_.push_back({StoreString(key), Value{}});
+}
+
+void DocumentBuilder::OnStartDict() {
+    frames_.push_back({/* is_dict */ true, members_.size()});
+}
+
+void DocumentBuilder::OnEndDict() {
+    const size_t begin = frames_.back().begin;
+    frames_.pop_back();
+
+    const auto first = members_.begin() + static_cast<std::ptrdiff_t>(begin);
+    std::sort(first, members_.end(), [](const Member& lhs, const Member& rhs) {
+        return lhs.key < rhs.key;
+    });
+    const auto duplicate = std::adjacent_find(first, members_.end(), [](const Member& lhs, const Member& rhs) {
+        return lhs.key == rhs.key;
+    });
+    if (duplicate != members_.end()) {
+        throw ParsingError("Duplicate key '"s + std::string(duplicate->key) + "' have been found");
+    }
+
+    const size_t size = members_.size() - begin;
+    Member* members = arena_.AllocateArray<Member>(size);
+    std::uninitialized_copy(first, members_.end(), members);
+    members_.resize(begin);
+    AddValue(Value::Dict(members, size));
+}
+
+void DocumentBuilder::OnStartArray() {
+    frames_.push_back({/* is_dict */ false, items_.size()});
+}
+
+void DocumentBuilder::OnEndArray() {
+    const size_t begin = frames_.back().begin;
+    frames_.pop_back();
+
+    const size_t size = items_.size() - begin;
+    Value* items = arena_.AllocateArray<Value>(size);
+    std::uninitialized_copy(items_.begin() + static_cast<std::ptrdiff_t>(begin), items_.end(), items);
+    items_.resize(begin);
+    AddValue(Value::Array(items, size));
+}
+
+Document DocumentBuilder::Build() {
+    Document result(root_, std::move(arena_));
+    arena_ = Arena{};
+    root_ = Value{};
+    return result;
+}
+
+// Значение внутри словаря относится к последнему прочитанному ключу
+void DocumentBuilder::AddValue(Value value) {
+    if (frames_.empty()) {
+        root_ = value;
+    } else if (frames_.back().is_dict) {
+        members_.back().value = value;
+    } else {
+        items_.push_back(value);
+    }
+}
+
+std::string_view DocumentBuilder::StoreString(std::string_view value) {
+    const std::less<const char*> before;
+    const char* input_end = retained_input_.data() + retained_input_.size();
+    if (!retained_input_.empty() && !before(value.data(), retained_input_.data())
+        && !before(input_end, value.data() + value.size())) {
+        return value;
+    }
+    return arena_.CopyString(value);
+}
+
+namespace {
+
+void EmitNode(const Node& node, Handler& handler) {
+    if (node.IsArray()) {
+        handler.OnStartArray();
+        for (const Node& item : node.AsArray()) {
+            EmitNode(item, handler);
+        }
+        handler.OnEndArray();
+    } else if (node.IsDict()) {
+        handler.OnStartDict();
+        for (const auto& [key, item] : node.AsDict()) {
+            handler.OnKey(key);
+            EmitNode(item, handler);
+        }
+        handler.OnEndDict();
+    } else if (node.IsString()) {
+        handler.OnString(node.AsString());
+    } else if (node.IsInt()) {
+        handler.OnInt(node.AsInt());
+    } else if (node.IsPureDouble()) {
+        handler.OnDouble(node.AsDouble());
+    } else if (node.IsBool()) {
+        handler.OnBool(node.AsBool());
+    } else {
+        handler.OnNull();
+    }
+}
+
+}  // namespace
+
+Document Load(std::string_view input, StringStorage storage) {
+    DocumentBuilder builder(storage == StringStorage::VIEW_INPUT ? input : std::string_view{});
+    Parse(input, builder);
+    return builder.Build();
+}
+
+Document FromNode(const Node& node) {
+    DocumentBuilder builder;
+    EmitNode(node, builder);
+    return builder.Build();
+}
+
+}  // namespace compact
+}  // namespace json
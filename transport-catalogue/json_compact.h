@@ -0,0 +1,305 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "json.h"
+
+namespace json {
+namespace compact {
+
+// Компактное представление документа JSON только для чтения. Значение занимает 16 байт:
+// тег типа, длина и данные либо указатель. Словари хранятся массивами пар, упорядоченными
+// по ключу, строки и массивы размещаются в арене документа и освобождаются вместе с ним
+class Value;
+
+struct Member;
+
+// Арена: память выделяется блоками и освобождается только целиком
+class Arena {
+public:
+    Arena() = default;
+    Arena(Arena&&) = default;
+    Arena& operator=(Arena&&) = default;
+
+    template <typename T>
+    T* AllocateArray(size_t count) {
+        return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    std::string_view CopyString(std::string_view value);
+
+private:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    void* Allocate(size_t size, size_t alignment);
+
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    char* pos_ = nullptr;
+    size_t available_ = 0;
+};
+
+class ArrayView {
+public:
+    ArrayView(const Value* items, size_t size)
+        : items_(items)
+        , size_(size) {
+    }
+
+    const Value* begin() const {
+        return items_;
+    }
+    const Value* end() const;
+    size_t size() const {
+        return size_;
+    }
+    bool empty() const {
+        return size_ == 0;
+    }
+    const Value& operator[](size_t index) const;
+
+private:
+    const Value* items_;
+    size_t size_;
+};
+
+class DictView {
+public:
+    DictView(const Member* members, size_t size)
+        : members_(members)
+        , size_(size) {
+    }
+
+    const Member* begin() const {
+        return members_;
+    }
+    const Member* end() const;
+    size_t size() const {
+        return size_;
+    }
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    // Двоичный поиск по ключу; nullptr, если ключа нет
+    const Value* find(std::string_view key) const;
+    // Как std::map::at: бросает std::out_of_range, если ключа нет
+    const Value& at(std::string_view key) const;
+
+private:
+    const Member* members_;
+    size_t size_;
+};
+
+class Value {
+public:
+    enum class Type : uint8_t { NUL, BOOL, INT, DOUBLE, STRING, ARRAY, DICT };
+
+    Value() = default;
+
+    static Value Null() {
+        return {};
+    }
+    static Value Bool(bool value) {
+        Value result(Type::BOOL, 0);
+        result.bool_ = value;
+        return result;
+    }
+    static Value Int(int value) {
+        Value result(Type::INT, 0);
+        result.int_ = value;
+        return result;
+    }
+    static Value Double(double value) {
+        Value result(Type::DOUBLE, 0);
+        result.double_ = value;
+        return result;
+    }
+    // Строка не копируется: память должна принадлежать документу
+    static Value String(std::string_view value) {
+        Value result(Type::STRING, static_cast<uint32_t>(value.size()));
+        result.string_ = value.data();
+        return result;
+    }
+    static Value Array(const Value* items, size_t size) {
+        Value result(Type::ARRAY, static_cast<uint32_t>(size));
+        result.items_ = items;
+        return result;
+    }
+    static Value Dict(const Member* members, size_t size) {
+        Value result(Type::DICT, static_cast<uint32_t>(size));
+        result.members_ = members;
+        return result;
+    }
+
+    Type GetType() const {
+        return type_;
+    }
+
+    bool IsNull() const {
+        return type_ == Type::NUL;
+    }
+    bool IsBool() const {
+        return type_ == Type::BOOL;
+    }
+    bool IsInt() const {
+        return type_ == Type::INT;
+    }
+    bool IsPureDouble() const {
+        return type_ == Type::DOUBLE;
+    }
+    bool IsDouble() const {
+        return IsInt() || IsPureDouble();
+    }
+    bool IsString() const {
+        return type_ == Type::STRING;
+    }
+    bool IsArray() const {
+        return type_ == Type::ARRAY;
+    }
+    bool IsDict() const {
+        return type_ == Type::DICT;
+    }
+
+    bool AsBool() const {
+        Check(IsBool(), "Not a bool");
+        return bool_;
+    }
+    int AsInt() const {
+        Check(IsInt(), "Not an int");
+        return int_;
+    }
+    double AsDouble() const {
+        Check(IsDouble(), "Not a double");
+        return IsPureDouble() ? double_ : int_;
+    }
+    std::string_view AsString() const {
+        Check(IsString(), "Not a string");
+        return {string_, size_};
+    }
+    ArrayView AsArray() const {
+        Check(IsArray(), "Not an array");
+        return {items_, size_};
+    }
+    DictView AsDict() const {
+        Check(IsDict(), "Not a dict");
+        return {members_, size_};
+    }
+
+private:
+    Value(Type type, uint32_t size)
+        : type_(type)
+        , size_(size) {
+    }
+
+    static void Check(bool condition, const char* message) {
+        if (!condition) {
+            throw std::logic_error(message);
+        }
+    }
+
+    Type type_ = Type::NUL;
+    // Длина строки или число элементов массива либо словаря
+    uint32_t size_ = 0;
+    union {
+        bool bool_;
+        int int_;
+        double double_ = 0;
+        const char* string_;
+        const Value* items_;
+        const Member* members_;
+    };
+};
+
+struct Member {
+    std::string_view key;
+    Value value;
+};
+
+inline const Value* ArrayView::end() const {
+    return items_ + size_;
+}
+
+inline const Value& ArrayView::operator[](size_t index) const {
+    return items_[index];
+}
+
+inline const Member* DictView::end() const {
+    return members_ + size_;
+}
+
+// Документ владеет ареной, в которой размещены все его строки, массивы и словари.
+// Перемещение документа не меняет адресов его значений
+class Document {
+public:
+    Document() = default;
+    Document(Value root, Arena arena)
+        : root_(root)
+        , arena_(std::move(arena)) {
+    }
+
+    const Value& GetRoot() const {
+        return root_;
+    }
+
+private:
+    Value root_;
+    Arena arena_;
+};
+
+// Строит компактный документ по событиям потокового разбора. Строки и ключи, лежащие внутри
+// retained_input, не копируются, а ссылаются прямо в него: такой буфер должен жить дольше
+// документа. Остальные строки (например, со снятым экранированием) копируются в арену
+class DocumentBuilder final : public Handler {
+public:
+    explicit DocumentBuilder(std::string_view retained_input = {})
+        : retained_input_(retained_input) {
+    }
+
+    void OnNull() override;
+    void OnBool(bool value) override;
+    void OnInt(int value) override;
+    void OnDouble(double value) override;
+    void OnString(std::string_view value) override;
+    void OnKey(std::string_view key) override;
+    void OnStartDict() override;
+    void OnEndDict() override;
+    void OnStartArray() override;
+    void OnEndArray() override;
+
+    // Возвращает построенный документ; построитель можно использовать заново
+    Document Build();
+
+private:
+    struct Frame {
+        bool is_dict;
+        size_t begin;
+    };
+
+    void AddValue(Value value);
+    std::string_view StoreString(std::string_view value);
+
+    std::string_view retained_input_;
+    Arena arena_;
+    Value root_;
+    std::vector<Frame> frames_;
+    // Элементы ещё не закрытых массивов и словарей; при закрытии копируются в арену
+    std::vector<Value> items_;
+    std::vector<Member> members_;
+};
+
+// Как хранить строки документа: копировать в арену или ссылаться во входной буфер
+enum class StringStorage { COPY, VIEW_INPUT };
+
+// При StringStorage::VIEW_INPUT input должен жить дольше документа
+Document Load(std::string_view input, StringStorage storage = StringStorage::COPY);
+// Строит компактную копию дерева json::Node
+Document FromNode(const Node& node);
+
+}  // namespace compact
+}  // namespace json
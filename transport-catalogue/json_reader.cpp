@@ -1,11 +1,22 @@
 #include "json_reader.h"
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
 #include <iomanip>
 #include <iostream>
+#include <iterator>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <utility>
+#include <variant>
 
 #include "json_builder.h"
+#include "json_compact.h"
+#include "json_writer.h"
+#include "unix_socket.h"
 
 /*
  * Здесь можно разместить код наполнения транспортного справочника данными из JSON,
@@ -15,58 +26,704 @@
 namespace transport_catalogue {
 namespace input {
 
+namespace {
+
+// Собирает события потокового разбора в обычное дерево json::Node
+class NodeBuilder final : public json::Handler {
+public:
+    void OnNull() override {
+        builder_->Value(nullptr);
+    }
+    void OnBool(bool value) override {
+        builder_->Value(value);
+    }
+    void OnInt(int value) override {
+        builder_->Value(value);
+    }
+    void OnDouble(double value) override {
+        builder_->Value(value);
+    }
+    void OnString(std::string_view value) override {
+        builder_->Value(std::string(value));
+    }
+    void OnKey(std::string_view key) override {
+        builder_->Key(std::string(key));
+    }
+    void OnStartDict() override {
+        builder_->StartDict();
+    }
+    void OnEndDict() override {
+        builder_->EndDict();
+    }
+    void OnStartArray() override {
+        builder_->StartArray();
+    }
+    void OnEndArray() override {
+        builder_->EndArray();
+    }
+
+    json::Node Build() {
+        json::Node result = builder_->Build();
+        // json::Builder хранит указатели на свой корень, поэтому пересоздаётся на месте
+        builder_.emplace();
+        return result;
+    }
+
+private:
+    std::optional<json::Builder> builder_{std::in_place};
+};
+
+// Потоковое наполнение справочника: элементы base_requests передаются в TransportCatalogue
+// сразу после разбора, без построения дерева. stat_requests собираются в компактный
+// документ, небольшие разделы настроек — в json::Node.
+// Расстояния до ещё не встречавшихся остановок и маршруты через такие остановки
+// откладываются до конца документа; маршруты добавляются в порядке входных данных
+class DocumentHandler final : public json::Handler {
+public:
+    // Если retained_input не пуст, это сохранённый справочником буфер разбираемого документа:
+    // строки запросов ссылаются в него без копирования
+    DocumentHandler(JsonReader& reader, TransportCatalogue& catalogue, std::string_view retained_input)
+        : reader_(reader)
+        , catalogue_(catalogue)
+        , requests_builder_(retained_input) {
+    }
+
+    void OnNull() override {
+        if (section_ == Section::OTHER) {
+            sink_->OnNull();
+            FinishScalar();
+        }
+    }
+
+    void OnBool(bool value) override {
+        if (section_ == Section::BASE_REQUESTS) {
+            if (depth_ == ITEM_DEPTH && field_ == "is_roundtrip") {
+                item_.is_roundtrip = value;
+            }
+        } else if (section_ == Section::OTHER) {
+            sink_->OnBool(value);
+            FinishScalar();
+        }
+    }
+
+    void OnInt(int value) override {
+        if (section_ == Section::BASE_REQUESTS) {
+            OnNumber(value);
+        } else if (section_ == Section::OTHER) {
+            sink_->OnInt(value);
+            FinishScalar();
+        }
+    }
+
+    void OnDouble(double value) override {
+        if (section_ == Section::BASE_REQUESTS) {
+            OnNumber(value);
+        } else if (section_ == Section::OTHER) {
+            sink_->OnDouble(value);
+            FinishScalar();
+        }
+    }
+
+    void OnString(std::string_view value) override {
+        if (section_ == Section::BASE_REQUESTS) {
+            if (depth_ == ITEM_DEPTH) {
+                if (field_ == "type") {
+                    item_.type = value == "Stop" ? ItemType::STOP : value == "Bus" ? ItemType::BUS : ItemType::UNKNOWN;
+                } else if (field_ == "name") {
+                    item_.name = catalogue_.InternName(value);
+                }
+            } else if (depth_ == FIELD_DEPTH && field_ == "stops") {
+                AddBusStop(value);
+            }
+        } else if (section_ == Section::OTHER) {
+            sink_->OnString(value);
+            FinishScalar();
+        }
+    }
+
+    void OnKey(std::string_view key) override {
+        if (depth_ == ROOT_DEPTH) {
+            if (key == "base_requests") {
+                section_ = Section::BASE_REQUESTS;
+            } else {
+                section_ = Section::OTHER;
+                section_key_.assign(key);
+                if (key == "stat_requests") {
+                    sink_ = &requests_builder_;
+                } else {
+                    sink_ = &settings_builder_;
+                }
+            }
+        } else if (section_ == Section::OTHER) {
+            sink_->OnKey(key);
+        } else if (section_ == Section::BASE_REQUESTS) {
+            if (depth_ == ITEM_DEPTH) {
+                field_.assign(key);
+            } else if (depth_ == FIELD_DEPTH) {
+                distance_key_ = catalogue_.InternName(key);
+            }
+        }
+    }
+
+    void OnStartDict() override {
+        ++depth_;
+        if (section_ == Section::OTHER) {
+            sink_->OnStartDict();
+        } else if (section_ == Section::BASE_REQUESTS && depth_ == ITEM_DEPTH) {
+            StartItem();
+        }
+    }
+
+    void OnEndDict() override {
+        --depth_;
+        if (section_ == Section::OTHER) {
+            sink_->OnEndDict();
+            if (depth_ == ROOT_DEPTH) {
+                FinishSection();
+            }
+        } else if (section_ == Section::BASE_REQUESTS && depth_ == LIST_DEPTH) {
+            CommitItem();
+        }
+    }
+
+    void OnStartArray() override {
+        ++depth_;
+        if (section_ == Section::OTHER) {
+            sink_->OnStartArray();
+        }
+    }
+
+    void OnEndArray() override {
+        --depth_;
+        if (section_ == Section::OTHER) {
+            sink_->OnEndArray();
+            if (depth_ == ROOT_DEPTH) {
+                FinishSection();
+            }
+        } else if (section_ == Section::BASE_REQUESTS && depth_ == ROOT_DEPTH) {
+            section_ = Section::ROOT;
+        }
+    }
+
+    // Добавляет в справочник всё, что было отложено до конца документа
+    void Flush() {
+        // Расстояния до неизвестных остановок пропускаются, как и раньше
+        for (const auto& [from, to, distance] : deferred_distances_) {
+            catalogue_.SetDistanceStops(catalogue_.FindStop(from), catalogue_.FindStop(to), distance);
+        }
+        deferred_distances_.clear();
+
+        std::vector<domain::Stop*> stops;
+        for (const PendingBus& pending : deferred_buses_) {
+            stops.clear();
+            for (const std::string_view name : pending.stop_names) {
+                stops.push_back(GetStop(name));
+            }
+            AddBus(pending.name, pending.is_roundtrip, stops);
+        }
+        deferred_buses_.clear();
+    }
+
+private:
+    // Глубина вложенности: корневой словарь, массив base_requests, словарь запроса
+    // и его поля road_distances и stops
+    static constexpr int ROOT_DEPTH = 1;
+    static constexpr int LIST_DEPTH = 2;
+    static constexpr int ITEM_DEPTH = 3;
+    static constexpr int FIELD_DEPTH = 4;
+
+    enum class Section { ROOT, BASE_REQUESTS, OTHER };
+    enum class ItemType { UNKNOWN, STOP, BUS };
+
+    // Поля текущего запроса base_requests, накопленные до закрытия его словаря
+    struct Item {
+        ItemType type = ItemType::UNKNOWN;
+        std::string_view name;
+        geo::Coordinates coordinates;
+        bool is_roundtrip = false;
+        std::vector<std::pair<std::string_view, double>> distances;
+        std::vector<domain::Stop*> stops;
+        // Названия остановок маршрута; заполняются, только если какая-то из них ещё не встречалась
+        std::vector<std::string_view> stop_names;
+    };
+
+    // Названия в отложенных данных принадлежат справочнику (TransportCatalogue::InternName)
+    struct PendingDistance {
+        std::string_view from;
+        std::string_view to;
+        double distance;
+    };
+
+    struct PendingBus {
+        std::string_view name;
+        bool is_roundtrip;
+        std::vector<std::string_view> stop_names;
+    };
+
+    // Раздел, значением которого было простое значение, закончен сразу
+    void FinishScalar() {
+        if (depth_ == ROOT_DEPTH) {
+            FinishSection();
+        }
+    }
+
+    void OnNumber(double value) {
+        if (depth_ == ITEM_DEPTH) {
+            if (field_ == "latitude") {
+                item_.coordinates.lat = value;
+            } else if (field_ == "longitude") {
+                item_.coordinates.lng = value;
+            }
+        } else if (depth_ == FIELD_DEPTH && field_ == "road_distances") {
+            item_.distances.emplace_back(distance_key_, value);
+        }
+    }
+
+    void FinishSection() {
+        if (sink_ == &requests_builder_) {
+            reader_.SetStatRequest(requests_builder_.Build());
+            section_ = Section::ROOT;
+            return;
+        }
+        json::Node node = settings_builder_.Build();
+        if (section_key_ == "render_settings") {
+            reader_.SetRenderSettings(std::move(std::get<json::Dict>(node.GetValue())));
+        } else if (section_key_ == "routing_settings") {
+            reader_.SetRoutingSettings(std::move(std::get<json::Dict>(node.GetValue())));
+        } else if (section_key_ == "serialization_settings") {
+            reader_.SetSerializationSettings(std::move(std::get<json::Dict>(node.GetValue())));
+        }
+        section_ = Section::ROOT;
+    }
+
+    void StartItem() {
+        item_.type = ItemType::UNKNOWN;
+        item_.name = {};
+        item_.coordinates = {};
+        item_.is_roundtrip = false;
+        item_.distances.clear();
+        item_.stops.clear();
+        item_.stop_names.clear();
+    }
+
+    void AddBusStop(std::string_view name) {
+        if (item_.stop_names.empty()) {
+            if (domain::Stop* stop = catalogue_.FindStop(name)) {
+                item_.stops.push_back(stop);
+                return;
+            }
+            for (const domain::Stop* stop : item_.stops) {
+                item_.stop_names.push_back(stop->name);
+            }
+        }
+        item_.stop_names.push_back(catalogue_.InternName(name));
+    }
+
+    void CommitItem() {
+        if (item_.type == ItemType::STOP) {
+            catalogue_.AddStop(item_.name, item_.coordinates);
+            domain::Stop* from = catalogue_.FindStop(item_.name);
+            for (const auto& [name, distance] : item_.distances) {
+                if (domain::Stop* to = catalogue_.FindStop(name)) {
+                    catalogue_.SetDistanceStops(from, to, distance);
+                } else {
+                    deferred_distances_.push_back({item_.name, name, distance});
+                }
+            }
+        } else if (item_.type == ItemType::BUS) {
+            // Если хотя бы один маршрут уже отложен, откладываются и все следующие,
+            // чтобы номера маршрутов совпадали с порядком во входных данных
+            if (item_.stop_names.empty() && deferred_buses_.empty()) {
+                AddBus(item_.name, item_.is_roundtrip, item_.stops);
+            } else {
+                if (item_.stop_names.empty()) {
+                    for (const domain::Stop* stop : item_.stops) {
+                        item_.stop_names.push_back(stop->name);
+                    }
+                }
+                deferred_buses_.push_back({item_.name, item_.is_roundtrip, std::move(item_.stop_names)});
+            }
+        }
+    }
+
+    // Остановка из списка остановок маршрута; неизвестная остановка — ошибка во входных данных
+    domain::Stop* GetStop(std::string_view name) const {
+        domain::Stop* stop = catalogue_.FindStop(name);
+        if (stop == nullptr) {
+            throw std::invalid_argument("Unknown stop: " + std::string(name));
+        }
+        return stop;
+    }
+
+    void AddBus(std::string_view name, bool is_roundtrip, const std::vector<domain::Stop*>& stops) {
+        domain::Bus bus;
+        bus.name_ = name;
+        bus.is_roundtrip_ = is_roundtrip;
+        bus.stops_ = stops;
+        if (!stops.empty()) {
+            bus.end_stop_ = stops.back();
+            if (!is_roundtrip) {
+                bus.stops_.insert(bus.stops_.end(), std::next(stops.rbegin()), stops.rend());
+            }
+        }
+        catalogue_.AddBus(bus);
+    }
+
+    JsonReader& reader_;
+    TransportCatalogue& catalogue_;
+
+    int depth_ = 0;
+    Section section_ = Section::ROOT;
+    std::string section_key_;
+    std::string field_;
+    std::string_view distance_key_;
+    json::Handler* sink_ = nullptr;
+    json::compact::DocumentBuilder requests_builder_;
+    NodeBuilder settings_builder_;
+
+    Item item_;
+    std::vector<PendingDistance> deferred_distances_;
+    std::vector<PendingBus> deferred_buses_;
+};
+
+// Ответ сервера на запрос, который не удалось обработать; request_id есть, если запрос
+// удалось разобрать и в нём указан id
+std::string FormatError(std::string_view message, std::optional<int> request_id, const json::PrintOptions& options) {
+    json::Writer writer(0, options);
+    writer.StartDict().Key("error_message").Value(message);
+    if (request_id) {
+        writer.Key("request_id").Value(*request_id);
+    }
+    writer.EndDict();
+    return writer.TakeBuffer();
+}
+
+}  // namespace
+
 JsonReader::JsonReader(TransportCatalogue& catalogue, map_renderer::MapRenderer& renderer/*, transport_router::TransportRouter& router*/)
     : catalogue_(catalogue)
     , renderer_(renderer)
     /*, router_(router)*/ {
 }
 
-void JsonReader::ApplyCommands(void) {
+void JsonReader::ReadDocument(std::string input) {
+    const std::string_view retained = catalogue_.RetainInput(std::move(input));
+    ParseDocument(retained, retained);
+    CompleteCatalogue();
+}
+
+void JsonReader::ReadDocument(std::string_view input) {
+    ParseDocument(input, {});
+    CompleteCatalogue();
+}
+
+void JsonReader::ReadRequests(std::string input) {
+    const std::string_view retained = catalogue_.RetainInput(std::move(input));
+    ParseDocument(retained, retained);
+    LoadBase();
+}
+
+void JsonReader::ParseDocument(std::string_view input, std::string_view retained_input) {
+    DocumentHandler handler(*this, catalogue_, retained_input);
+    json::Parse(input, handler);
+    handler.Flush();
+}
+
+void JsonReader::CompleteCatalogue(void) {
+    renderer_.SetSettings(GetRenderSettings());
+    snapshot_.emplace(catalogue_.Freeze());
+    FillRenderer();
+}
+
+const std::string& JsonReader::GetSnapshotPath(void) const {
+    return serialization_settings_.at("file").AsString();
+}
+
+void JsonReader::SaveBase(void) const {
+    // Настройки сохраняются в снимке текстом JSON; кратчайшая запись чисел восстанавливает их точно
+    json::Dict settings;
+    settings.emplace("render_settings", render_settings_);
+    settings.emplace("routing_settings", routing_settings_);
+    // Путь к файлу маршрутизатора, заданный явно, нужен serve: ему известен только путь снимка
+    if (const auto it = serialization_settings_.find("router_file"); it != serialization_settings_.end()) {
+        settings.emplace("router_file", it->second);
+    }
+    std::ostringstream metadata;
+    json::Print(json::Document(json::Node(std::move(settings))), metadata,
+                json::PrintOptions{number_format::Precision::Shortest(), true});
+
+    snapshot_->Save(GetSnapshotPath(), metadata.str());
+
+    if (!routing_settings_.empty()) {
+        // Маршрутизатор строится сейчас, чтобы process_requests загрузил его готовым
+        transport_router::TransportRouter router(GetRoutingSettings(), *snapshot_, GetRouterCachePath());
+    }
+}
+
+std::string JsonReader::GetRouterCachePath(void) const {
+    if (const auto it = serialization_settings_.find("router_file"); it != serialization_settings_.end()) {
+        return it->second.AsString();
+    }
+    return GetSnapshotPath() + ".router";
+}
+
+void JsonReader::LoadBase(void) {
+    // Данные справочника используются прямо из отображённого файла, разбираются только настройки
+    snapshot_.emplace(CatalogueSnapshot::Load(GetSnapshotPath()));
+    const json::Document metadata = json::Load(snapshot_->GetMetadata());
+    const json::Dict& settings = metadata.GetRoot().AsDict();
+    render_settings_ = settings.at("render_settings").AsDict();
+    routing_settings_ = settings.at("routing_settings").AsDict();
+    // router_file из запроса важнее сохранённого в снимке
+    if (const auto it = settings.find("router_file"); it != settings.end()) {
+        serialization_settings_.emplace("router_file", it->second);
+    }
+
     renderer_.SetSettings(GetRenderSettings());
-    //router_.SetSettings(GetRoutingSettings());
-    AddStops();
-    AddDistances();
-    AddBuses();
+    FillRenderer();
+}
+
+const transport_router::TransportRouter& JsonReader::GetRouter(void) {
+    // Маршрутизатор нужен только запросам Route, а его построение — самая долгая часть подготовки,
+    // поэтому он строится при первой необходимости. Остальные потоки ждут окончания построения
+    std::call_once(router_once_, [this] {
+        // Если справочник сохраняется в файл, граф и таблицы маршрутизатора берутся из файла рядом с ним
+        if (serialization_settings_.count("file") != 0) {
+            router_.emplace(GetRoutingSettings(), *snapshot_, GetRouterCachePath());
+        } else {
+            router_.emplace(GetRoutingSettings(), *snapshot_);
+        }
+        router_ready_ = true;
+    });
+    return *router_;
+}
+
+void JsonReader::BuildRouterInBackground(void) {
+    if (router_thread_.joinable()) {
+        return;
+    }
+    router_thread_ = std::thread([this] {
+        try {
+            GetRouter();
+        } catch (...) {
+            // Ошибка построения повторится и будет выдана при первом запросе Route
+        }
+    });
+}
+
+JsonReader::~JsonReader() {
+    if (router_thread_.joinable()) {
+        router_thread_.join();
+    }
 }
 
 void JsonReader::AnswersRequests(std::ostream& out) {
-    json::Array doc;
-    std::stringstream output;
+    const auto requests = stat_requests_.GetRoot().AsArray();
+
+    // Ответы записываются в поток по мере формирования, без построения общего дерева
+    json::Writer writer(out, print_options_);
+    writer.StartArray();
+
+    // Запросы Route ждут маршрутизатор, который строится в фоне, пока формируются ответы
+    // на остальные запросы
+    std::vector<size_t> route_requests;
+    for (size_t i = 0; i < requests.size(); ++i) {
+        if (IsRouteRequest(requests[i])) {
+            route_requests.push_back(i);
+        }
+    }
+    if (!route_requests.empty()) {
+        BuildRouterInBackground();
+    }
 
-    transport_router::TransportRouter router_(GetRoutingSettings(), catalogue_);
+    const size_t thread_count = std::min(thread_count_ == 0 ? std::max(1u, std::thread::hardware_concurrency())
+                                                            : thread_count_,
+                                         std::max<size_t>(requests.size(), 1));
+    if (thread_count == 1) {
+        AnswerRequestsInOrder(requests, route_requests.empty() ? requests.size() : route_requests.front(), writer);
+    } else {
+        // Каждый ответ форматируется в свою заранее выделенную ячейку по номеру запроса,
+        // поэтому порядок вывода не зависит от того, в каком потоке и когда был обработан запрос
+        std::vector<std::string> answers(requests.size());
+        std::vector<size_t> other_requests;
+        for (size_t i = 0, route = 0; i < requests.size(); ++i) {
+            if (route < route_requests.size() && route_requests[route] == i) {
+                ++route;
+            } else {
+                other_requests.push_back(i);
+            }
+        }
+        AnswerRequests(requests, other_requests, thread_count, writer, answers);
+        AnswerRequests(requests, route_requests, thread_count, writer, answers);
 
-    for(auto& el : stat_requests_) {
-        if(el.AsDict().at("type").AsString() == "Map") {
-            doc.emplace_back(PrintMap(el));
+        for (const std::string& answer : answers) {
+            if (!answer.empty()) {
+                writer.RawValue(answer);
+            }
         }
+    }
 
-        if(el.AsDict().at("type").AsString() == "Bus") {
-            doc.emplace_back(PrintBusInfo(el));
+    writer.EndArray();
+}
+
+void JsonReader::AnswerRequestsInOrder(json::compact::ArrayView requests, size_t first_route, json::Writer& writer) {
+    // Ответы до первого запроса Route выводятся сразу
+    for (size_t i = 0; i < first_route; ++i) {
+        AnswerRequest(requests[i], writer);
+    }
+
+    // Пока маршрутизатор строится в фоне, следующие запросы кроме Route отвечаются заранее
+    // и ждут своей очереди. Как только он готов, заготовка прекращается, чтобы не держать
+    // в памяти ответы на весь остаток пакета (например, копии карты)
+    std::vector<std::string> prepared;
+    for (size_t i = first_route; i < requests.size() && !router_ready_; ++i) {
+        json::Writer answer(writer.GetDepth(), writer.GetOptions());
+        if (!IsRouteRequest(requests[i])) {
+            AnswerRequest(requests[i], answer);
         }
+        prepared.push_back(answer.TakeBuffer());
+    }
 
-        if(el.AsDict().at("type").AsString() == "Stop") {
-            doc.emplace_back(PrintStopInfo(el));
+    // Дальше ответы снова выводятся по порядку, а заготовленные освобождаются сразу после вывода
+    for (size_t i = first_route; i < requests.size(); ++i) {
+        const size_t slot = i - first_route;
+        if (slot < prepared.size() && !IsRouteRequest(requests[i])) {
+            if (!prepared[slot].empty()) {
+                writer.RawValue(prepared[slot]);
+            }
+            std::string().swap(prepared[slot]);
+        } else {
+            AnswerRequest(requests[i], writer);
         }
+    }
+}
 
-        if(el.AsDict().at("type").AsString() == "Route") {
-            doc.emplace_back(PrintRoute(el, router_));
+bool JsonReader::IsRouteRequest(const json::compact::Value& request) {
+    if (!request.IsDict()) {
+        return false;
+    }
+    const json::compact::Value* type = request.AsDict().find("type");
+    return type != nullptr && type->IsString() && type->AsString() == "Route";
+}
+
+void JsonReader::AnswerRequests(json::compact::ArrayView requests, const std::vector<size_t>& indices,
+                                size_t thread_count, const json::Writer& writer, std::vector<std::string>& answers) {
+    thread_count = std::min(thread_count, indices.size());
+    std::atomic<size_t> next = 0;
+    std::vector<std::exception_ptr> errors(thread_count);
+    const auto worker = [&](size_t worker_id) {
+        try {
+            for (size_t k = next++; k < indices.size(); k = next++) {
+                json::Writer answer(writer.GetDepth(), writer.GetOptions());
+                AnswerRequest(requests[indices[k]], answer);
+                answers[indices[k]] = answer.TakeBuffer();
+            }
+        } catch (...) {
+            errors[worker_id] = std::current_exception();
+            next = indices.size();
         }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(thread_count > 0 ? thread_count - 1 : 0);
+    for (size_t worker_id = 1; worker_id < thread_count; ++worker_id) {
+        workers.emplace_back(worker, worker_id);
+    }
+    if (thread_count > 0) {
+        worker(0);
+    }
+    for (auto& thread : workers) {
+        thread.join();
+    }
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+void JsonReader::ServeRequests(std::istream& in, std::ostream& out) {
+    // Ответ должен занимать одну строку
+    json::PrintOptions options = print_options_;
+    options.compact = true;
+
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+        std::string text;
+        std::optional<int> request_id;
+        try {
+            const json::compact::Document request = json::compact::Load(line, json::compact::StringStorage::VIEW_INPUT);
+            const json::compact::Value& root = request.GetRoot();
+            if (root.IsDict()) {
+                if (const json::compact::Value* id = root.AsDict().find("id"); id != nullptr && id->IsInt()) {
+                    request_id = id->AsInt();
+                }
+            }
+            json::Writer answer(0, options);
+            AnswerRequest(root, answer);
+            text = answer.TakeBuffer();
+            if (text.empty()) {
+                text = FormatError("unknown request type", request_id, options);
+            }
+        } catch (const std::exception& e) {
+            text = FormatError(e.what(), request_id, options);
+        }
+        text.push_back('\n');
+        out << text << std::flush;
+    }
+}
+
+void JsonReader::AnswerRequest(const json::compact::Value& request, json::Writer& writer) {
+    const std::string_view type = request.AsDict().at("type").AsString();
+
+    if(type == "Map") {
+        // Отрисовка карты меняет состояние MapRenderer, поэтому выполняется по одному запросу
+        std::lock_guard<std::mutex> guard(map_mutex_);
+        PrintMap(request, writer);
+    } else if(type == "Bus") {
+        PrintBusInfo(request, writer);
+    } else if(type == "Stop") {
+        PrintStopInfo(request, writer);
+    } else if(type == "Route") {
+        PrintRoute(request, GetRouter(), writer);
     }
-    
-    json::Print(json::Document(doc), out);
 }
 
 void LoadJSON(JsonReader& reader, std::istream& in, std::ostream& out) {
-    json::Document doc = json::Load(in);
-    const auto load_dict = doc.GetRoot().AsDict();
-    reader.SetBaseRequest(load_dict.at("base_requests").AsArray());
-    reader.SetStatRequest(load_dict.at("stat_requests").AsArray());
-    reader.SetRenderSettings(load_dict.at("render_settings").AsDict());
-    reader.SetRoutingSettings(load_dict.at("routing_settings").AsDict());
-    reader.ApplyCommands();
+    // Входные данные читаются одним блоком и разбираются из памяти без построения дерева.
+    // Буфер остаётся у справочника, и названия остановок и маршрутов ссылаются прямо в него
+    reader.ReadDocument(std::string{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()});
     reader.AnswersRequests(out);
 }
 
+void MakeBase(JsonReader& reader, std::istream& in) {
+    reader.ReadDocument(std::string{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()});
+    reader.SaveBase();
+}
+
+void ProcessRequests(JsonReader& reader, std::istream& in, std::ostream& out) {
+    reader.ReadRequests(std::string{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()});
+    reader.AnswersRequests(out);
+}
+
+void Serve(JsonReader& reader, const std::string& snapshot_path, const std::string& socket_path,
+           std::istream& in, std::ostream& out) {
+    reader.SetSerializationSettings(json::Dict{{"file", snapshot_path}});
+    reader.LoadBase();
+    // Запросы Bus, Stop и Map обслуживаются сразу, пока маршрутизатор строится
+    reader.BuildRouterInBackground();
+    if (socket_path.empty()) {
+        reader.ServeRequests(in, out);
+    } else {
+        io::ServeUnixSocket(socket_path, [&reader](std::istream& session_in, std::ostream& session_out) {
+            reader.ServeRequests(session_in, session_out);
+        });
+    }
+}
+
 map_renderer::RenderSettings JsonReader::GetRenderSettings(void) {
     map_renderer::RenderSettings result;
     result.width_ = render_settings_.at("width").AsDouble();
@@ -99,44 +756,70 @@ map_renderer::RenderSettings JsonReader::GetRenderSettings(void) {
     return result;
 }
 
-transport_router::RoutingSettings JsonReader::GetRoutingSettings(void) {
+transport_router::RoutingSettings JsonReader::GetRoutingSettings(void) const {
     transport_router::RoutingSettings result;
 
     result.bus_wait_time = routing_settings_.at("bus_wait_time").AsInt();
     result.bus_velocity = routing_settings_.at("bus_velocity").AsDouble();
 
+    if (const auto it = routing_settings_.find("graph_model"); it != routing_settings_.end()) {
+        result.graph_model = GetGraphModel(it->second.AsString());
+    }
+    if (const auto it = routing_settings_.find("routing_mode"); it != routing_settings_.end()) {
+        result.mode = GetRoutingMode(it->second.AsString());
+    }
+    if (const auto it = routing_settings_.find("all_pairs_vertex_limit"); it != routing_settings_.end()) {
+        result.all_pairs_vertex_limit = static_cast<size_t>(it->second.AsInt());
+    }
+
     return result;
 }
 
-svg::Color JsonReader::GetColor(const json::Node& el) const {
-    using namespace std::string_literals;
-    std::stringstream color;
-    if(el.IsString()) {
-        color << el.AsString();
-    } else if(el.IsArray()) {
-        if(el.AsArray().size() == 3) {
-            color << "rgb("s;
-        } else {
-            color << "rgba("s;
-        }
-        
-        bool is_not_first = false;
-        for(uint32_t i = 0; i < 3; i++) {
-            if(is_not_first) {
-                color << ","s;
-            }
-            color << el.AsArray()[i].AsInt();
-            is_not_first = true;
-        }
+transport_router::GraphModel JsonReader::GetGraphModel(const std::string& model) const {
+    using transport_router::GraphModel;
+    if (model == "dense") {
+        return GraphModel::DENSE;
+    }
+    if (model == "transfer") {
+        return GraphModel::TRANSFER;
+    }
+    throw std::invalid_argument("Unknown graph model: " + model);
+}
 
-        if(el.AsArray().size() == 4) {
-            color << ","s;
-            color << el.AsArray()[3].AsDouble();
-        }
+transport_router::RoutingMode JsonReader::GetRoutingMode(const std::string& mode) const {
+    using transport_router::RoutingMode;
+    if (mode == "auto") {
+        return RoutingMode::AUTO;
+    }
+    if (mode == "all_pairs") {
+        return RoutingMode::ALL_PAIRS;
+    }
+    if (mode == "dijkstra") {
+        return RoutingMode::DIJKSTRA;
+    }
+    if (mode == "contraction_hierarchy") {
+        return RoutingMode::CONTRACTION_HIERARCHY;
+    }
+    throw std::invalid_argument("Unknown routing mode: " + mode);
+}
 
-        color << ")"s;
+svg::Color JsonReader::GetColor(const json::Node& el) const {
+    // Цвета из массивов передаются в SVG числами: прозрачность выводится ColorPrinter
+    // по общей политике точности, без потоков и локали
+    if (el.IsString()) {
+        return el.AsString();
+    }
+    if (!el.IsArray()) {
+        return std::string();
     }
-    return color.str();
+    const json::Array& components = el.AsArray();
+    const auto channel = [&components](size_t index) {
+        return static_cast<uint8_t>(components.at(index).AsInt());
+    };
+    if (components.size() == 4) {
+        return svg::Rgba(channel(0), channel(1), channel(2), components[3].AsDouble());
+    }
+    return svg::Rgb(channel(0), channel(1), channel(2));
 }
 
 json::Document LoadJSON(const std::string& s) {
@@ -144,151 +827,112 @@ json::Document LoadJSON(const std::string& s) {
     return json::Load(strm);
 }
 
-json::Node JsonReader::PrintMap(const json::Node& request) {
-    using namespace std::string_literals;
-    std::stringstream output;
-
-    renderer_.RenderMap().Render(output);
-    return  json::Builder{}.StartDict()
-                    .Key("request_id"s)
-                    .Value(request.AsDict().at("id"s).AsInt())
-                    .Key("map"s).Value(output.str())
-                    .EndDict()
-                    .Build();
+// Ключи ответов записываются в алфавитном порядке, как их упорядочивает json::Print
+void JsonReader::PrintMap(const json::compact::Value& request, json::Writer& writer) {
+    // Карта отрисовывается и экранируется один раз, повторные запросы берут её из кэша
+    writer.StartDict()
+        .Key("map").RawValue(renderer_.GetMapJsonString(print_options_.numbers))
+        .Key("request_id").Value(request.AsDict().at("id").AsInt())
+        .EndDict();
 }
 
-json::Node JsonReader::PrintBusInfo(const json::Node& request) {
-    using namespace std::string_literals;
-    domain::BusInfo bus = catalogue_.GetBusInfo(request.AsDict().at("name"s).AsString());
-    
-    json::Builder answer = json::Builder{};
-    answer.StartDict().Key("request_id"s).Value(request.AsDict().at("id"s).AsInt());
+void JsonReader::PrintBusInfo(const json::compact::Value& request, json::Writer& writer) {
+    domain::BusInfo bus = snapshot_->GetBusInfo(request.AsDict().at("name").AsString());
+    const int request_id = request.AsDict().at("id").AsInt();
+
+    writer.StartDict();
     if(bus.name.empty()) {
-        answer.Key("error_message"s).Value("not found"s);
+        writer.Key("error_message").Value("not found")
+            .Key("request_id").Value(request_id);
     } else {
-        answer.Key("curvature"s).Value(bus.route_curvature);
-        answer.Key("route_length"s).Value(bus.route_length);
-        answer.Key("stop_count"s).Value(static_cast<int>(bus.count_all_stops));
-        answer.Key("unique_stop_count"s).Value(static_cast<int>(bus.count_unique_stops));
+        writer.Key("curvature").Value(bus.route_curvature)
+            .Key("request_id").Value(request_id)
+            .Key("route_length").Value(bus.route_length)
+            .Key("stop_count").Value(static_cast<int>(bus.count_all_stops))
+            .Key("unique_stop_count").Value(static_cast<int>(bus.count_unique_stops));
     }
-
-    return answer.EndDict().Build();
+    writer.EndDict();
 }
 
-json::Node JsonReader::PrintStopInfo(const json::Node& request) {
-    using namespace std::string_literals;
-    domain::StopInfo stop = catalogue_.GetStopInfo(request.AsDict().at("name"s).AsString());
+void JsonReader::PrintStopInfo(const json::compact::Value& request, json::Writer& writer) {
+    domain::StopInfo stop = snapshot_->GetStopInfo(request.AsDict().at("name").AsString());
+    const int request_id = request.AsDict().at("id").AsInt();
 
-    json::Builder answer = json::Builder{};
-    answer.StartDict().Key("request_id"s).Value(request.AsDict().at("id"s).AsInt());
+    writer.StartDict();
     if(stop.name.empty()) {
-        answer.Key("error_message"s).Value("not found"s);
+        writer.Key("error_message").Value("not found");
     } else {
-        answer.Key("buses"s).StartArray();
+        writer.Key("buses").StartArray();
         for(const auto bus : stop.buses) {
-            answer.Value(std::string(bus));
+            writer.Value(bus);
         }
-        answer.EndArray();
+        writer.EndArray();
     }
-    
-    return answer.EndDict().Build();
+    writer.Key("request_id").Value(request_id).EndDict();
 }
 
-json::Node JsonReader::PrintRoute(const json::Node& request, transport_router::TransportRouter& router) {
-    using namespace std::string_literals;
+void JsonReader::PrintRoute(const json::compact::Value& request, const transport_router::TransportRouter& router,
+                            json::Writer& writer) {
+    const int request_id = request.AsDict().at("id").AsInt();
 
-    json::Builder answer = json::Builder{};
-    answer.StartDict();
-
-    domain::Stop* from = catalogue_.FindStop(request.AsDict().at("from").AsString());
-    domain::Stop* to = catalogue_.FindStop(request.AsDict().at("to").AsString());
+    const auto from = snapshot_->FindStop(request.AsDict().at("from").AsString());
+    const auto to = snapshot_->FindStop(request.AsDict().at("to").AsString());
 
+    writer.StartDict();
     if (from == to) {
-        answer.Key("total_time"s).Value(0)
-            .Key("request_id"s).Value(request.AsDict().at("id").AsInt())
-            .Key("items"s)
-            .StartArray()
-            .EndArray();
-    } else {
-        const auto route = router.FindRoute(from, to);
-        
-        if (route.has_value()) {
-            const auto& elem = route.value().route_points;
-            json::Array items;
-            for (const auto& el : elem) {
-                items.push_back(json::Builder().StartDict()
-                    .Key("time").Value(router.GetBusWaitTime())
-                    .Key("type").Value("Wait")
-                    .Key("stop_name").Value(el.from->name)
-                    .EndDict().Build());
-                items.push_back(json::Builder().StartDict()
-                    .Key("time"s).Value(el.wait_time)
-                    .Key("span_count"s).Value(el.span_count)
-                    .Key("bus"s).Value(el.bus)
-                    .Key("type"s).Value("Bus"s)
-                    .EndDict().Build());
-            }
-            answer.Key("total_time"s).Value(route.value().duration)
-                .Key("request_id"s).Value(request.AsDict().at("id").AsInt())
-                .Key("items"s).Value(items);
-        } else {
-            answer.Key("request_id"s).Value(request.AsDict().at("id").AsInt())
-                .Key("error_message").Value("not found"s);
-        }
-    }
-
-    return answer.EndDict().Build();
-}
-
-void JsonReader::AddStops(void) const {
-    // Add all stops
-    for(auto& el : base_requests_) {
-        if (el.AsDict().at("type").AsString() == "Stop") {
-            catalogue_.AddStop(el.AsDict().at("name").AsString(), {el.AsDict().at("latitude").AsDouble(), el.AsDict().at("longitude").AsDouble()});
+        writer.Key("items").StartArray().EndArray()
+            .Key("request_id").Value(request_id)
+            .Key("total_time").Value(0);
+    } else if (const auto route = from && to ? router.FindRoute(*from, *to) : std::nullopt) {
+        writer.Key("items").StartArray();
+        for (const auto& el : route->route_points) {
+            writer.StartDict()
+                .Key("stop_name").Value(snapshot_->GetStopName(el.from))
+                .Key("time").Value(router.GetBusWaitTime())
+                .Key("type").Value("Wait")
+                .EndDict();
+            writer.StartDict()
+                .Key("bus").Value(el.bus)
+                .Key("span_count").Value(el.span_count)
+                .Key("time").Value(el.wait_time)
+                .Key("type").Value("Bus")
+                .EndDict();
         }
+        writer.EndArray()
+            .Key("request_id").Value(request_id)
+            .Key("total_time").Value(route->duration);
+    } else {
+        writer.Key("error_message").Value("not found")
+            .Key("request_id").Value(request_id);
     }
+    writer.EndDict();
 }
 
-void JsonReader::AddDistances(void) const {
-    // Add all distances
-    for(const auto& el : base_requests_) {
-        if (el.AsDict().at("type").AsString() == "Stop") {
-            for(const auto& [key, value] : el.AsDict().at("road_distances").AsDict()) {                
-                catalogue_.SetDistanceStops(catalogue_.FindStop(el.AsDict().at("name").AsString()), catalogue_.FindStop(key), value.AsDouble());
-            }
-        }
-    }
-}
+void JsonReader::FillRenderer(void) const {
+    // Маршруты берутся из снимка, поэтому карта строится одинаково и после загрузки снимка из файла
+    const CatalogueSnapshot& snapshot = *snapshot_;
+    const auto make_stop = [&snapshot](domain::StopId id) {
+        map_renderer::StopSVG stop;
+        stop.name_ = snapshot.GetStopName(id);
+        stop.coordinates_ = snapshot.GetStopCoordinates(id);
+        return stop;
+    };
 
-void JsonReader::AddBuses(void) const {
-    // Add all buses
     std::vector<geo::Coordinates> all_coordinates;
-    for(const auto& el : base_requests_) {
-        if (el.AsDict().at("type").AsString() == "Bus") {
-            domain::Bus bus;
-            bus.name_ = el.AsDict().at("name").AsString();
-            bool is_roundtrip = el.AsDict().at("is_roundtrip").AsBool();
-            bus.is_roundtrip_ = is_roundtrip;
-            
-
-            for(const auto& stop : el.AsDict().at("stops").AsArray()) {
-                bus.stops_.push_back(catalogue_.FindStop(stop.AsString()));
-            }
-
-            bus.end_stop_ = bus.stops_.back();
-
-            if(!is_roundtrip) {
-                for(int i = static_cast<int>(el.AsDict().at("stops").AsArray().size()) - 2; i >= 0; --i) {
-                    bus.stops_.push_back(catalogue_.FindStop(el.AsDict().at("stops").AsArray()[static_cast<uint32_t>(i)].AsString()));
-                }
-            }
-
-            for(const auto& stop : bus.stops_) {
-                all_coordinates.push_back(stop->coordinates);
-            }
-            catalogue_.AddBus(bus);
-            renderer_.AddRoute(catalogue_.FindBus(bus.name_));
+    for (domain::BusId bus = 0; bus < snapshot.GetBusesCount(); ++bus) {
+        const auto end_stop = snapshot.GetBusEndStop(bus);
+        if (!end_stop) {
+            continue;
+        }
+        map_renderer::RouteSVG route;
+        route.name_ = snapshot.GetBusName(bus);
+        route.is_roundtrip_ = snapshot.IsRoundtrip(bus);
+        route.end_stop_ = make_stop(*end_stop);
+        for (const domain::StopId stop : snapshot.GetBusStops(bus)) {
+            all_coordinates.push_back(snapshot.GetStopCoordinates(stop));
+            route.stops_.push_back(make_stop(stop));
         }
+        renderer_.AddRoute(std::move(route));
     }
 
     renderer_.SetSphereProjector(all_coordinates);
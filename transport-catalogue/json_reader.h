@@ -5,7 +5,18 @@
  * а также код обработки запросов к базе и формирование массива ответов в формате JSON
  */
 
+#include <atomic>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
 #include "json.h"
+#include "json_compact.h"
+#include "json_writer.h"
 #include "transport_catalogue.h"
 #include "map_renderer.h"
 #include "request_handler.h"
@@ -18,51 +29,136 @@ class JsonReader {
 public:
     JsonReader(TransportCatalogue& catalogue, map_renderer::MapRenderer& renderer/*, transport_router::TransportRouter& router*/);
 
+    JsonReader(const JsonReader&) = delete;
+    JsonReader& operator=(const JsonReader&) = delete;
+
+    // Дожидается фонового построения маршрутизатора, если оно было запущено
+    ~JsonReader();
+
     map_renderer::RenderSettings GetRenderSettings(void);
 
-    transport_router::RoutingSettings GetRoutingSettings(void);
+    transport_router::RoutingSettings GetRoutingSettings(void) const;
+
+    // Потоково разбирает входной документ: base_requests сразу попадают в справочник,
+    // остальные разделы сохраняются, после чего справочник готов к запросам
+    void ReadDocument(std::string_view input);
+    // То же, но буфер передаётся справочнику, и названия ссылаются в него без копирования
+    void ReadDocument(std::string input);
 
-    void ApplyCommands(void);
+    // Разбирает документ с запросами stat_requests и загружает справочник из снимка,
+    // файл которого указан в serialization_settings
+    void ReadRequests(std::string input);
+
+    // Сохраняет снимок справочника вместе с настройками отрисовки и маршрутизации
+    // в файл из serialization_settings, а граф и таблицы маршрутизатора — в файл
+    // serialization_settings.router_file (по умолчанию — путь снимка с суффиксом .router).
+    // Заданный router_file запоминается в снимке, и LoadBase находит файл маршрутизатора по нему
+    void SaveBase(void) const;
 
     void AnswersRequests(std::ostream& out);
 
-    void SetBaseRequest(const json::Array& base_requests) {
-        base_requests_ = base_requests;
+    // Загружает справочник из снимка, файл которого указан в serialization_settings;
+    // после этого можно вызывать ServeRequests
+    void LoadBase(void);
+
+    // Запускает построение маршрутизатора в фоновом потоке, не дожидаясь первого запроса Route.
+    // Без этого маршрутизатор строится при первом запросе Route
+    void BuildRouterInBackground(void);
+
+    // Отвечает на запросы, по одному JSON-словарю в строке (NDJSON), пока не закончится in.
+    // Ответ на каждый запрос — одна строка компактного JSON, поток сбрасывается после каждого ответа.
+    // Ошибочный запрос получает ответ с error_message и не прерывает обработку.
+    // Можно вызывать из нескольких потоков одновременно
+    void ServeRequests(std::istream& in, std::ostream& out);
+
+    void SetStatRequest(json::compact::Document stat_requests) {
+        stat_requests_ = std::move(stat_requests);
     }
 
     void SetStatRequest(const json::Array& stat_requests) {
-        stat_requests_ = stat_requests;
+        stat_requests_ = json::compact::FromNode(json::Node(stat_requests));
     }
 
-    void SetRenderSettings(const json::Dict& render_settings) {
-        render_settings_ = render_settings;
+    void SetRenderSettings(json::Dict render_settings) {
+        render_settings_ = std::move(render_settings);
     }
 
-    void SetRoutingSettings(const json::Dict& routing_settings) {
-        routing_settings_ = routing_settings;
+    void SetRoutingSettings(json::Dict routing_settings) {
+        routing_settings_ = std::move(routing_settings);
+    }
+
+    void SetSerializationSettings(json::Dict serialization_settings) {
+        serialization_settings_ = std::move(serialization_settings);
+    }
+
+    // Число потоков, в которых обрабатываются запросы stat_requests: 1 — последовательно,
+    // 0 — по числу ядер
+    void SetThreadCount(size_t thread_count) {
+        thread_count_ = thread_count;
+    }
+
+    // Настройки вывода ответов, в том числе точность чисел в JSON и в SVG карты
+    void SetPrintOptions(const json::PrintOptions& options) {
+        print_options_ = options;
     }
 private:
-    void AddStops(void) const;
-    void AddDistances(void) const;
-    void AddBuses(void) const;
+    void ParseDocument(std::string_view input, std::string_view retained_input);
+    void CompleteCatalogue(void);
+    const transport_router::TransportRouter& GetRouter(void);
+    const std::string& GetSnapshotPath(void) const;
+    std::string GetRouterCachePath(void) const;
+    void FillRenderer(void) const;
     svg::Color GetColor(const json::Node& el) const;
-
-    json::Node PrintMap(const json::Node& request);
-    json::Node PrintBusInfo(const json::Node& request);
-    json::Node PrintStopInfo(const json::Node& request);
-    json::Node PrintRoute(const json::Node& request, transport_router::TransportRouter& router);
+    transport_router::GraphModel GetGraphModel(const std::string& model) const;
+    transport_router::RoutingMode GetRoutingMode(const std::string& mode) const;
+
+    void PrintMap(const json::compact::Value& request, json::Writer& writer);
+    void PrintBusInfo(const json::compact::Value& request, json::Writer& writer);
+    void PrintStopInfo(const json::compact::Value& request, json::Writer& writer);
+    void PrintRoute(const json::compact::Value& request, const transport_router::TransportRouter& router, json::Writer& writer);
+    void AnswerRequest(const json::compact::Value& request, json::Writer& writer);
+    // Формирует ответы на запросы requests[indices[k]] в ячейки answers с теми же номерами,
+    // в thread_count потоках, с глубиной и настройками вывода writer
+    void AnswerRequests(json::compact::ArrayView requests, const std::vector<size_t>& indices, size_t thread_count,
+                        const json::Writer& writer, std::vector<std::string>& answers);
+    // Отвечает на запросы в текущем потоке, выводя ответы по порядку; first_route — номер
+    // первого запроса Route (requests.size(), если их нет)
+    void AnswerRequestsInOrder(json::compact::ArrayView requests, size_t first_route, json::Writer& writer);
+    static bool IsRouteRequest(const json::compact::Value& request);
 
     TransportCatalogue& catalogue_;
+    // Снимок справочника после ReadDocument или LoadBase, на нём выполняются запросы Bus и Stop
+    std::optional<CatalogueSnapshot> snapshot_;
     map_renderer::MapRenderer& renderer_;
     //transport_router::TransportRouter& router_;
 
-    json::Array base_requests_;
-    json::Array stat_requests_;
+    // Запросы хранятся компактным документом: их может быть очень много
+    json::compact::Document stat_requests_;
     json::Dict render_settings_;
     json::Dict routing_settings_;
+    json::Dict serialization_settings_;
+
+    size_t thread_count_ = 1;
+    json::PrintOptions print_options_;
+    std::mutex map_mutex_;
+    // Строится один раз при первом обращении через GetRouter, из любого потока,
+    // и дальше переиспользуется, например между запросами сервера
+    std::optional<transport_router::TransportRouter> router_;
+    std::once_flag router_once_;
+    // Становится true, когда router_ построен; позволяет узнать это, не дожидаясь построения
+    std::atomic<bool> router_ready_ = false;
+    std::thread router_thread_;
 };
 
 void LoadJSON(JsonReader& reader, std::istream& in, std::ostream& out);
+// Режим make_base: наполняет справочник и сохраняет его снимок
+void MakeBase(JsonReader& reader, std::istream& in);
+// Режим process_requests: отвечает на запросы по сохранённому снимку, не наполняя справочник заново
+void ProcessRequests(JsonReader& reader, std::istream& in, std::ostream& out);
+// Режим сервера: справочник и маршрутизатор загружаются из снимка snapshot_path один раз, затем
+// запросы NDJSON читаются из in, а если задан socket_path — из подключений к сокету Unix
+void Serve(JsonReader& reader, const std::string& snapshot_path, const std::string& socket_path,
+           std::istream& in, std::ostream& out);
 
 }; //namespace input
 }; //namespace transport_catalogue
\ No newline at end of file
@@ -0,0 +1,192 @@
+#include "json_writer.h"
+
+#include <stdexcept>
+#include <type_traits>
+#include <variant>
+
+using namespace std::literals;
+
+namespace json {
+
+Writer::Writer(std::ostream& output, const PrintOptions& options)
+    : output_(&output)
+    , options_(options)
+{}
+
+Writer::Writer(size_t depth, const PrintOptions& options)
+    : base_depth_(depth)
+    , options_(options)
+{}
+
+Writer::~Writer() {
+    Flush();
+}
+
+Writer& Writer::StartDict() {
+    BeginValue();
+    buffer_.push_back('{');
+    WriteNewLine();
+    stack_.push_back({/* is_dict */ true});
+    return *this;
+}
+
+Writer& Writer::EndDict() {
+    EndContainer(/* is_dict */ true);
+    buffer_.push_back('}');
+    MaybeFlush();
+    return *this;
+}
+
+Writer& Writer::StartArray() {
+    BeginValue();
+    buffer_.push_back('[');
+    WriteNewLine();
+    stack_.push_back({/* is_dict */ false});
+    return *this;
+}
+
+Writer& Writer::EndArray() {
+    EndContainer(/* is_dict */ false);
+    buffer_.push_back(']');
+    MaybeFlush();
+    return *this;
+}
+
+Writer& Writer::Key(std::string_view key) {
+    if (stack_.empty() || !stack_.back().is_dict || stack_.back().has_key) {
+        throw std::logic_error("Key() outside a dict"s);
+    }
+    Level& level = stack_.back();
+    if (!level.is_empty) {
+        buffer_.push_back(',');
+        WriteNewLine();
+    }
+    level.is_empty = false;
+    level.has_key = true;
+    WriteIndent(GetDepth());
+    AppendString(buffer_, key);
+    buffer_ += options_.compact ? ":"sv : ": "sv;
+    return *this;
+}
+
+Writer& Writer::Value(std::nullptr_t) {
+    BeginValue();
+    buffer_ += "null"sv;
+    return *this;
+}
+
+Writer& Writer::Value(bool value) {
+    BeginValue();
+    buffer_ += value ? "true"sv : "false"sv;
+    return *this;
+}
+
+Writer& Writer::Value(int value) {
+    BeginValue();
+    number_format::Append(buffer_, value);
+    return *this;
+}
+
+Writer& Writer::Value(double value) {
+    BeginValue();
+    number_format::Append(buffer_, value, options_.numbers);
+    return *this;
+}
+
+Writer& Writer::Value(std::string_view value) {
+    BeginValue();
+    AppendString(buffer_, value);
+    MaybeFlush();
+    return *this;
+}
+
+Writer& Writer::Value(const Node& node) {
+    if (node.IsArray()) {
+        StartArray();
+        for (const Node& item : node.AsArray()) {
+            Value(item);
+        }
+        return EndArray();
+    }
+    if (node.IsDict()) {
+        StartDict();
+        for (const auto& [key, item] : node.AsDict()) {
+            Key(key);
+            Value(item);
+        }
+        return EndDict();
+    }
+    std::visit(
+        [this](const auto& value) {
+            using Type = std::decay_t<decltype(value)>;
+            if constexpr (!std::is_same_v<Type, Array> && !std::is_same_v<Type, Dict>) {
+                Value(value);
+            }
+        },
+        node.GetValue());
+    return *this;
+}
+
+Writer& Writer::RawValue(std::string_view json) {
+    BeginValue();
+    buffer_ += json;
+    MaybeFlush();
+    return *this;
+}
+
+void Writer::Flush() {
+    if (output_ != nullptr && !buffer_.empty()) {
+        output_->write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+        buffer_.clear();
+    }
+}
+
+// Значение в массиве начинается с новой строки с отступом, в словаре — сразу после ключа
+void Writer::BeginValue() {
+    if (stack_.empty()) {
+        return;
+    }
+    Level& level = stack_.back();
+    if (level.is_dict) {
+        if (!level.has_key) {
+            throw std::logic_error("Value() in a dict without a key"s);
+        }
+        level.has_key = false;
+        return;
+    }
+    if (!level.is_empty) {
+        buffer_.push_back(',');
+        WriteNewLine();
+    }
+    level.is_empty = false;
+    WriteIndent(GetDepth());
+}
+
+void Writer::EndContainer(bool is_dict) {
+    if (stack_.empty() || stack_.back().is_dict != is_dict || stack_.back().has_key) {
+        throw std::logic_error(is_dict ? "EndDict() outside a dict"s : "EndArray() outside an array"s);
+    }
+    stack_.pop_back();
+    WriteNewLine();
+    WriteIndent(GetDepth());
+}
+
+void Writer::WriteIndent(size_t depth) {
+    if (!options_.compact) {
+        buffer_.append(depth * static_cast<size_t>(indent_step_), ' ');
+    }
+}
+
+void Writer::WriteNewLine() {
+    if (!options_.compact) {
+        buffer_.push_back('\n');
+    }
+}
+
+void Writer::MaybeFlush() {
+    if (buffer_.size() >= FLUSH_THRESHOLD) {
+        Flush();
+    }
+}
+
+}  // namespace json
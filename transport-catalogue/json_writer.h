@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "json.h"
+
+namespace json {
+
+// Потоковая запись JSON с тем же интерфейсом, что у Builder, но без построения дерева:
+// значения сразу форматируются в буфер, который сбрасывается в поток по мере заполнения.
+// Форматирование, в том числе компактное, совпадает с json::Print. Print выводит ключи
+// словаря по алфавиту, а Writer — в порядке вызовов Key, поэтому для одинакового вывода
+// ключи нужно передавать упорядоченными
+class Writer {
+public:
+    // Запись в поток output
+    explicit Writer(std::ostream& output, const PrintOptions& options = {});
+    // Запись в строку. Значение форматируется так, как если бы
+    // оно было вложено в depth контейнеров; результат забирается через TakeBuffer
+    // и вставляется в другой Writer через RawValue
+    explicit Writer(size_t depth = 0, const PrintOptions& options = {});
+
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    ~Writer();
+
+    Writer& StartDict();
+    Writer& EndDict();
+    Writer& StartArray();
+    Writer& EndArray();
+    Writer& Key(std::string_view key);
+
+    Writer& Value(std::nullptr_t);
+    Writer& Value(bool value);
+    Writer& Value(int value);
+    Writer& Value(double value);
+    Writer& Value(std::string_view value);
+    Writer& Value(const char* value) {
+        return Value(std::string_view(value));
+    }
+    Writer& Value(const std::string& value) {
+        return Value(std::string_view(value));
+    }
+    Writer& Value(const Node& node);
+
+    // Вставляет значение, уже отформатированное другим Writer с соответствующей глубиной
+    Writer& RawValue(std::string_view json);
+
+    // Глубина вложенности текущей позиции записи
+    size_t GetDepth() const {
+        return base_depth_ + stack_.size();
+    }
+
+    const PrintOptions& GetOptions() const {
+        return options_;
+    }
+
+    // Забирает текст, записанный в строку
+    std::string TakeBuffer() {
+        return std::move(buffer_);
+    }
+
+    // Передаёт накопленный текст в поток; для записи в строку ничего не делает
+    void Flush();
+
+private:
+    struct Level {
+        bool is_dict;
+        bool is_empty = true;
+        bool has_key = false;
+    };
+
+    static constexpr size_t FLUSH_THRESHOLD = 1 << 16;
+
+    void BeginValue();
+    void EndContainer(bool is_dict);
+    void WriteIndent(size_t depth);
+    void WriteNewLine();
+    void MaybeFlush();
+
+    // nullptr при записи в строку
+    std::ostream* output_ = nullptr;
+    std::string buffer_;
+    std::vector<Level> stack_;
+    size_t base_depth_ = 0;
+    PrintOptions options_;
+    int indent_step_ = 4;
+};
+
+}  // namespace json
@@ -1,17 +1,96 @@
 #include <iostream>
+#include <optional>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 
 #include "json_reader.h"
 #include "map_renderer.h"
 
 using namespace std;
 
-int main() {
+namespace {
+
+// Неотрицательное целое число из аргумента командной строки; nullopt, если аргумент не такое число
+optional<int> ParseNonNegative(const string& text) {
+    try {
+        size_t parsed = 0;
+        const int value = stoi(text, &parsed);
+        if (parsed == text.size() && value >= 0) {
+            return value;
+        }
+    } catch (const invalid_argument&) {
+    } catch (const out_of_range&) {
+    }
+    return nullopt;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
     transport_catalogue::TransportCatalogue catalogue;
     map_renderer::MapRenderer renderer;
     //transport_router::TransportRouter router;
     transport_catalogue::input::JsonReader reader(catalogue, renderer);
-    LoadJSON(reader, cin, cout);
+
+    // make_base: наполнить справочник и сохранить снимок в файл из serialization_settings
+    // process_requests: ответить на stat_requests по сохранённому снимку
+    // serve SNAPSHOT [--socket PATH]: загрузить снимок один раз и отвечать на запросы NDJSON
+    // из стандартного ввода или из подключений к сокету Unix
+    // Без режима справочник наполняется и запросы обрабатываются за один запуск
+    // --threads N: обрабатывать запросы в N потоках (0 — по числу ядер)
+    // --precision shortest|N: кратчайшая точная запись чисел или N значащих цифр
+    // --compact: ответы без отступов и переводов строк
+    json::PrintOptions print_options;
+    string_view mode;
+    string snapshot_path;
+    string socket_path;
+    const auto print_usage = [argv] {
+        cerr << "Usage: "sv << argv[0] << " [make_base|process_requests|serve SNAPSHOT [--socket PATH]] [--threads N] [--precision shortest|N] [--compact]"sv << endl;
+    };
+    for (int i = 1; i < argc; ++i) {
+        if (i == 1 && (argv[i] == "make_base"s || argv[i] == "process_requests"s)) {
+            mode = argv[i];
+        } else if (i == 1 && argv[i] == "serve"s && i + 1 < argc) {
+            mode = argv[i];
+            snapshot_path = argv[++i];
+        } else if (argv[i] == "--socket"s && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (argv[i] == "--threads"s && i + 1 < argc) {
+            const optional<int> thread_count = ParseNonNegative(argv[++i]);
+            if (!thread_count) {
+                print_usage();
+                return 1;
+            }
+            reader.SetThreadCount(static_cast<size_t>(*thread_count));
+        } else if (argv[i] == "--precision"s && i + 1 < argc) {
+            const string precision = argv[++i];
+            if (precision == "shortest"sv) {
+                print_options.numbers = number_format::Precision::Shortest();
+            } else if (const optional<int> digits = ParseNonNegative(precision)) {
+                print_options.numbers = number_format::Precision::General(*digits);
+            } else {
+                print_usage();
+                return 1;
+            }
+        } else if (argv[i] == "--compact"s) {
+            print_options.compact = true;
+        } else {
+            print_usage();
+            return 1;
+        }
+    }
+    reader.SetPrintOptions(print_options);
+
+    if (mode == "make_base"sv) {
+        MakeBase(reader, cin);
+    } else if (mode == "process_requests"sv) {
+        ProcessRequests(reader, cin, cout);
+    } else if (mode == "serve"sv) {
+        Serve(reader, snapshot_path, socket_path, cin, cout);
+    } else {
+        LoadJSON(reader, cin, cout);
+    }
 
     return 0;
 }
\ No newline at end of file
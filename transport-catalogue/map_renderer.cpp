@@ -1,5 +1,9 @@
 #include "map_renderer.h"
 
+#include <utility>
+
+#include "json.h"
+
 /*
  * В этом файле вы можете разместить код, отвечающий за визуализацию карты маршрутов в формате SVG.
  * Визуализация маршртутов вам понадобится во второй части итогового проекта.
@@ -17,24 +21,30 @@ bool compare_stop_svg(const StopSVG& lhs, const StopSVG& rhs) {
 
 void MapRenderer::SetSettings(const RenderSettings& settings) {
     render_settings_ = settings;
+    cache_.reset();
 }
 
-void MapRenderer::AddRoute(domain::Bus* bus) {
+void MapRenderer::AddRoute(const domain::Bus& bus) {
     RouteSVG route;
-    for(const auto& stop : bus->stops_) {
+    for(const auto& stop : bus.stops_) {
         StopSVG add_stop;
         add_stop.name_ = stop->name;
         add_stop.coordinates_ = stop->coordinates;
         route.stops_.push_back(add_stop);
     }
 
-    route.end_stop_.name_ = bus->end_stop_->name;
-    route.end_stop_.coordinates_ = bus->end_stop_->coordinates;
+    route.end_stop_.name_ = bus.end_stop_->name;
+    route.end_stop_.coordinates_ = bus.end_stop_->coordinates;
+
+    route.name_ = bus.name_;
+    route.is_roundtrip_ = bus.is_roundtrip_;
+    AddRoute(std::move(route));
+}
 
-    route.name_ = bus->name_;
-    route.is_roundtrip_ = bus->is_roundtrip_;
+void MapRenderer::AddRoute(RouteSVG route) {
     if(route.stops_.size() > 0) {
-        routes_.push_back(route);
+        routes_.push_back(std::move(route));
+        cache_.reset();
     }
 }
 
@@ -42,6 +52,7 @@ void MapRenderer::SetSphereProjector(std::vector<geo::Coordinates>& coordinates)
     projector_ = SphereProjector(coordinates.begin(), coordinates.end(), 
                                 render_settings_.width_, render_settings_.height_,
                                 render_settings_.padding_);
+    cache_.reset();
 }
 
 std::vector<svg::Polyline> MapRenderer::GetRoutes() {
@@ -180,6 +191,8 @@ std::set<StopSVG> MapRenderer::GetStopsSVG() {
 
 svg::Document MapRenderer::RenderMap() {
     svg::Document result;
+    // Цвета назначаются с начала палитры при каждой отрисовке
+    inst_color_ = 0;
 
     std::sort(routes_.begin(), routes_.end(), compare_route_svg);
 
@@ -209,4 +222,24 @@ svg::Document MapRenderer::RenderMap() {
     return result;
 }
 
+MapRenderer::RenderCache& MapRenderer::GetRenderCache(number_format::Precision numbers) {
+    if (!cache_ || cache_->numbers != numbers) {
+        cache_ = RenderCache{numbers, {}};
+    }
+    return *cache_;
+}
+
+const std::string& MapRenderer::GetMapJsonString(number_format::Precision numbers) {
+    RenderCache& cache = GetRenderCache(numbers);
+    if (cache.json_string.empty()) {
+        // SVG выводится сразу в строку JSON через экранирующий буфер, без промежуточного текста
+        cache.json_string.push_back('"');
+        json::EscapingStreambuf escaper(cache.json_string);
+        std::ostream out(&escaper);
+        RenderMap().Render(out, numbers);
+        cache.json_string.push_back('"');
+    }
+    return cache.json_string;
+}
+
 }; //namespace map_renderer
\ No newline at end of file
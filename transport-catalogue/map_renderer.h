@@ -1,11 +1,14 @@
 #pragma once
 
 #include <algorithm>
+#include <optional>
+#include <string>
 #include <vector>
 
 #include "svg.h"
 #include "geo.h"
 #include "domain.h"
+#include "number_format.h"
 
 /*
  * В этом файле вы можете разместить код, отвечающий за визуализацию карты маршрутов в формате SVG.
@@ -136,13 +139,28 @@ public:
     MapRenderer(const RenderSettings& settings)
         : render_settings_(settings) {};
 
-    void AddRoute(domain::Bus* bus);
+    void AddRoute(const domain::Bus& bus);
+    // Маршрут без остановок не рисуется
+    void AddRoute(RouteSVG route);
     void SetSettings(const RenderSettings& settings);
 
     svg::Document RenderMap();
 
+    // Текст SVG карты как строка JSON (в кавычках, с экранированием). Результат запоминается
+    // и строится заново, только если изменились маршруты, настройки, проекция или политика
+    // вывода чисел. Ссылка действительна до следующего такого изменения
+    const std::string& GetMapJsonString(number_format::Precision numbers = {});
+
     void SetSphereProjector(std::vector<geo::Coordinates>& coordinates);
 private:
+    struct RenderCache {
+        number_format::Precision numbers;
+        // Строится при первом запросе
+        std::string json_string;
+    };
+
+    RenderCache& GetRenderCache(number_format::Precision numbers);
+
     svg::Color NextColor(void) {
         if(render_settings_.color_palette_.size() == 0) {
             return svg::Rgb();
@@ -168,6 +186,7 @@ private:
     uint32_t inst_color_ = 0;
     std::vector<RouteSVG> routes_;
     SphereProjector projector_;
+    std::optional<RenderCache> cache_;
 };
 
 }; //map_renderer
\ No newline at end of file
@@ -0,0 +1,164 @@
+#include "mapped_file.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#include <iterator>
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace io {
+
+using namespace std::literals;
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& path, Access) {
+    std::ifstream input(path, std::ios::binary);
+    if (!input) {
+        throw std::runtime_error("Failed to open "s + path);
+    }
+    buffer_.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : buffer_(std::move(other.buffer_)) {
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+    other.data_ = nullptr;
+    other.size_ = 0;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    buffer_ = std::move(other.buffer_);
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+    other.data_ = nullptr;
+    other.size_ = 0;
+    return *this;
+}
+
+void MappedFile::Release() {
+    buffer_.clear();
+    data_ = nullptr;
+    size_ = 0;
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path, Access access) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open "s + path);
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+        close(fd);
+        throw std::runtime_error("Failed to stat "s + path);
+    }
+    size_ = static_cast<size_t>(file_stat.st_size);
+    if (size_ > 0) {
+        void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Failed to map "s + path);
+        }
+        // Последовательное чтение выигрывает от упреждающей подкачки. При произвольном доступе
+        // она только вытесняет нужные страницы, поэтому файл целиком подкачивается заранее
+        // и дальше читается без упреждения
+        if (access == Access::SEQUENTIAL) {
+            madvise(data, size_, MADV_SEQUENTIAL);
+        } else {
+            madvise(data, size_, MADV_RANDOM);
+            madvise(data, size_, MADV_WILLNEED);
+        }
+        data_ = static_cast<const char*>(data);
+    }
+    close(fd);
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : data_(std::exchange(other.data_, nullptr))
+    , size_(std::exchange(other.size_, 0)) {
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        Release();
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+    }
+    return *this;
+}
+
+void MappedFile::Release() {
+    if (data_ != nullptr) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+}
+
+#endif
+
+MappedFile::~MappedFile() {
+    Release();
+}
+
+namespace {
+
+// Имя временного файла рядом с path, своё у каждого вызова: процессы и потоки, одновременно
+// записывающие один и тот же файл, не пишут в общий временный файл
+std::string MakeTempPath(const std::string& path) {
+    static std::atomic<uint64_t> counter = 0;
+#ifdef _WIN32
+    const auto pid = _getpid();
+#else
+    const auto pid = getpid();
+#endif
+    return path + "."s + std::to_string(pid) + "."s + std::to_string(counter++) + ".tmp"s;
+}
+
+}  // namespace
+
+void ReplaceFile(const std::string& path, const std::function<void(std::ostream& output)>& write) {
+    const std::string temp_path = MakeTempPath(path);
+    std::ofstream output(temp_path, std::ios::binary | std::ios::trunc);
+    if (!output) {
+        throw std::runtime_error("Failed to open "s + temp_path);
+    }
+    try {
+        write(output);
+        output.close();
+    } catch (...) {
+        output.close();
+        std::remove(temp_path.c_str());
+        throw;
+    }
+    if (!output) {
+        std::remove(temp_path.c_str());
+        throw std::runtime_error("Failed to write "s + temp_path);
+    }
+#ifdef _WIN32
+    // rename в Windows не заменяет существующий файл
+    std::remove(path.c_str());
+#endif
+    if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+        std::remove(temp_path.c_str());
+        throw std::runtime_error("Failed to replace "s + path);
+    }
+}
+
+}  // namespace io
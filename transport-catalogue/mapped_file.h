@@ -0,0 +1,53 @@
+#pragma once
+
+#include <functional>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace io {
+
+// Файл, отображённый в память только для чтения. Данные доступны, пока жив объект
+class MappedFile {
+public:
+    // Как будет читаться файл; от этого зависит подсказка ядру о подкачке страниц
+    enum class Access {
+        // Один проход от начала до конца, как при разборе JSON
+        SEQUENTIAL,
+        // Обращения вразнобой всё время жизни объекта, как к снимку справочника
+        RANDOM,
+    };
+
+    explicit MappedFile(const std::string& path, Access access = Access::SEQUENTIAL);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    ~MappedFile();
+
+    std::string_view GetData() const {
+        return {data_, size_};
+    }
+
+private:
+    void Release();
+
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    // Без POSIX mmap файл читается в память целиком
+    std::string buffer_;
+#endif
+};
+
+// Записывает файл path через write во временный файл рядом с ним и затем переименовывает его
+// в path. Процессы, отобразившие прежний файл в память, продолжают видеть его старое содержимое.
+// Одновременные вызовы для одного path пишут каждый в свой временный файл, и остаётся файл
+// последнего переименования. Бросает std::runtime_error, если файл не удалось записать,
+// а исключения из write пропускает дальше; прежний файл при этом не меняется,
+// а временный удаляется
+void ReplaceFile(const std::string& path, const std::function<void(std::ostream& output)>& write);
+
+}  // namespace io
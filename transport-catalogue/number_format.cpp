@@ -0,0 +1,51 @@
+#include "number_format.h"
+
+#include <algorithm>
+#include <charconv>
+
+namespace number_format {
+
+char* Format(char* first, char* last, double value, Precision precision) {
+    std::to_chars_result result;
+    switch (precision.mode) {
+        case Precision::Mode::SHORTEST:
+            result = std::to_chars(first, last, value);
+            break;
+        case Precision::Mode::FIXED:
+            result = std::to_chars(first, last, value, std::chars_format::fixed,
+                                   std::clamp(precision.digits, 0, MAX_FIXED_DIGITS));
+            break;
+        default:
+            // Как и у printf("%g"), нулевая точность означает одну значащую цифру
+            result = std::to_chars(first, last, value, std::chars_format::general,
+                                   std::clamp(precision.digits, 1, 17));
+            break;
+    }
+    return result.ptr;
+}
+
+char* Format(char* first, char* last, int value) {
+    return std::to_chars(first, last, value).ptr;
+}
+
+void Append(std::string& out, double value, Precision precision) {
+    char buffer[BUFFER_SIZE];
+    out.append(buffer, Format(buffer, buffer + BUFFER_SIZE, value, precision));
+}
+
+void Append(std::string& out, int value) {
+    char buffer[16];
+    out.append(buffer, Format(buffer, buffer + sizeof(buffer), value));
+}
+
+void Write(std::ostream& out, double value, Precision precision) {
+    char buffer[BUFFER_SIZE];
+    out.write(buffer, Format(buffer, buffer + BUFFER_SIZE, value, precision) - buffer);
+}
+
+void Write(std::ostream& out, int value) {
+    char buffer[16];
+    out.write(buffer, Format(buffer, buffer + sizeof(buffer), value) - buffer);
+}
+
+}  // namespace number_format
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+namespace number_format {
+
+// Политика вывода чисел с плавающей точкой
+struct Precision {
+    enum class Mode {
+        // Кратчайшая запись, которая читается обратно в то же самое число
+        SHORTEST,
+        // Как у std::ostream: digits значащих цифр (не больше 17), экспонента при необходимости
+        GENERAL,
+        // digits цифр после десятичной точки
+        FIXED,
+    };
+
+    static Precision Shortest() {
+        return {Mode::SHORTEST, 0};
+    }
+    static Precision General(int digits) {
+        return {Mode::GENERAL, digits};
+    }
+    static Precision Fixed(int digits) {
+        return {Mode::FIXED, digits};
+    }
+
+    // По умолчанию вывод совпадает с std::ostream без дополнительных настроек
+    Mode mode = Mode::GENERAL;
+    int digits = 6;
+};
+
+inline bool operator==(const Precision& lhs, const Precision& rhs) {
+    return lhs.mode == rhs.mode && (lhs.mode == Precision::Mode::SHORTEST || lhs.digits == rhs.digits);
+}
+
+inline bool operator!=(const Precision& lhs, const Precision& rhs) {
+    return !(lhs == rhs);
+}
+
+// Цифр после точки в режиме FIXED не больше этого числа
+inline constexpr int MAX_FIXED_DIGITS = 64;
+// Размер буфера, которого хватает для любого числа при любой политике
+inline constexpr size_t BUFFER_SIZE = 400;
+
+// Записывает число в [first, last) без учёта локали и возвращает указатель за последним
+// записанным символом. Буфера размером BUFFER_SIZE достаточно всегда
+char* Format(char* first, char* last, double value, Precision precision = {});
+char* Format(char* first, char* last, int value);
+
+void Append(std::string& out, double value, Precision precision = {});
+void Append(std::string& out, int value);
+
+void Write(std::ostream& out, double value, Precision precision = {});
+void Write(std::ostream& out, int value);
+
+}  // namespace number_format
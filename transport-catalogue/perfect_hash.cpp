@@ -0,0 +1,111 @@
+#include "perfect_hash.h"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+namespace transport_catalogue {
+
+    namespace {
+        // Средний размер корзины: чем он больше, тем меньше таблица смещений,
+        // но тем дольше подбираются смещения при построении
+        const size_t KEYS_PER_BUCKET = 4;
+        const uint32_t MAX_DISPLACEMENT = 1u << 24;
+
+        uint64_t Mix(uint64_t value) {
+            value ^= value >> 33;
+            value *= 0xff51afd7ed558ccdULL;
+            value ^= value >> 33;
+            value *= 0xc4ceb9fe1a85ec53ULL;
+            value ^= value >> 33;
+            return value;
+        }
+    }
+
+    uint64_t PerfectHash::Hash(std::string_view key) {
+        // FNV-1a с финальным перемешиванием
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        for (const char c : key) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 0x100000001b3ULL;
+        }
+        return Mix(hash);
+    }
+
+    size_t PerfectHash::GetSlot(uint64_t hash, uint32_t displacement, size_t slot_count) {
+        return static_cast<size_t>(Mix(hash ^ (uint64_t{displacement} * 0x9e3779b97f4a7c15ULL)) % slot_count);
+    }
+
+    PerfectHash::PerfectHash(const std::vector<std::string_view>& keys) {
+        using namespace std::string_literals;
+        const size_t key_count = keys.size();
+        if (key_count == 0) {
+            return;
+        }
+
+        const size_t bucket_count = (key_count + KEYS_PER_BUCKET - 1) / KEYS_PER_BUCKET;
+        std::vector<uint64_t> hashes(key_count);
+        std::vector<std::vector<uint32_t>> buckets(bucket_count);
+        for (uint32_t key = 0; key < key_count; ++key) {
+            hashes[key] = Hash(keys[key]);
+            buckets[hashes[key] % bucket_count].push_back(key);
+        }
+
+        // Большие корзины размещаем первыми, пока свободных ячеек много
+        std::vector<size_t> order(bucket_count);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&buckets](size_t lhs, size_t rhs) {
+            return buckets[lhs].size() > buckets[rhs].size();
+        });
+
+        displacements_.assign(bucket_count, 0);
+        slots_.assign(key_count, 0);
+        std::vector<bool> taken(key_count, false);
+        std::vector<size_t> bucket_slots;
+        for (const size_t bucket : order) {
+            if (buckets[bucket].empty()) {
+                break;
+            }
+            uint32_t displacement = 0;
+            for (;; ++displacement) {
+                if (displacement == MAX_DISPLACEMENT) {
+                    throw std::runtime_error("Failed to build perfect hash, duplicate keys?"s);
+                }
+                bucket_slots.clear();
+                bool fits = true;
+                for (const uint32_t key : buckets[bucket]) {
+                    const size_t slot = GetSlot(hashes[key], displacement, key_count);
+                    if (taken[slot] || std::find(bucket_slots.begin(), bucket_slots.end(), slot) != bucket_slots.end()) {
+                        fits = false;
+                        break;
+                    }
+                    bucket_slots.push_back(slot);
+                }
+                if (fits) {
+                    break;
+                }
+            }
+
+            displacements_[bucket] = displacement;
+            for (size_t i = 0; i < bucket_slots.size(); ++i) {
+                taken[bucket_slots[i]] = true;
+                slots_[bucket_slots[i]] = buckets[bucket][i];
+            }
+        }
+    }
+
+    std::optional<uint32_t> PerfectHash::Lookup(std::string_view key) const {
+        return Lookup(key, displacements_.data(), displacements_.size(), slots_.data(), slots_.size());
+    }
+
+    std::optional<uint32_t> PerfectHash::Lookup(std::string_view key, const uint32_t* displacements,
+                                                size_t displacement_count, const uint32_t* slots, size_t slot_count) {
+        if (slot_count == 0) {
+            return std::nullopt;
+        }
+        const uint64_t hash = Hash(key);
+        const uint32_t displacement = displacements[hash % displacement_count];
+        return slots[GetSlot(hash, displacement, slot_count)];
+    }
+
+};
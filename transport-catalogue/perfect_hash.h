@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace transport_catalogue {
+
+    // Минимальная совершенная хеш-функция (схема hash-and-displace) над фиксированным набором
+    // строк: каждая из n строк попадает в свою ячейку из n. Строка хешируется один раз,
+    // затем номер корзины и смещение корзины дают ячейку. Для строки не из набора функция
+    // возвращает произвольную ячейку, поэтому вызывающий сверяет найденную строку сам
+    class PerfectHash {
+    public:
+        PerfectHash() = default;
+        explicit PerfectHash(const std::vector<std::string_view>& keys);
+
+        // Номер ключа (индекс в keys), который мог бы совпасть с key
+        std::optional<uint32_t> Lookup(std::string_view key) const;
+
+        // То же по готовым таблицам смещений и ячеек, например отображённым из файла снимка
+        static std::optional<uint32_t> Lookup(std::string_view key, const uint32_t* displacements,
+                                              size_t displacement_count, const uint32_t* slots, size_t slot_count);
+
+        size_t Size() const {
+            return slots_.size();
+        }
+
+        const std::vector<uint32_t>& GetDisplacements() const {
+            return displacements_;
+        }
+
+        const std::vector<uint32_t>& GetSlots() const {
+            return slots_;
+        }
+
+        static uint64_t Hash(std::string_view key);
+        static size_t GetSlot(uint64_t hash, uint32_t displacement, size_t slot_count);
+
+    private:
+        // Смещение i-й корзины: displacements_[i]; slots_[ячейка] — номер ключа
+        std::vector<uint32_t> displacements_;
+        std::vector<uint32_t> slots_;
+    };
+
+};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <iterator>
 #include <string_view>
 #include <unordered_map>
@@ -12,6 +13,7 @@ class Range {
 public:
     using ValueType = typename std::iterator_traits<It>::value_type;
 
+    Range() = default;
     Range(It begin, It end)
         : begin_(begin)
         , end_(end) {
@@ -22,10 +24,20 @@ public:
     It end() const {
         return end_;
     }
+    size_t size() const {
+        return static_cast<size_t>(std::distance(begin_, end_));
+    }
+    bool empty() const {
+        return begin_ == end_;
+    }
+    // Только для итераторов произвольного доступа
+    decltype(auto) operator[](size_t index) const {
+        return begin_[index];
+    }
 
 private:
-    It begin_;
-    It end_;
+    It begin_{};
+    It end_{};
 };
 
 template <typename C>
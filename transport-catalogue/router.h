@@ -4,17 +4,72 @@
 
 #include <algorithm>
 #include <cassert>
+#include <condition_variable>
 #include <cstdint>
 #include <iterator>
+#include <limits>
+#include <mutex>
 #include <optional>
 #include <stdexcept>
+#include <thread>
+#include <type_traits>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
 namespace graph {
 
+// Точка синхронизации потоков между фазами предрасчёта: ArriveAndWait возвращает управление,
+// когда его вызвали все thread_count потоков; барьер можно проходить многократно
+class PhaseBarrier {
+public:
+    explicit PhaseBarrier(size_t thread_count)
+        : thread_count_(thread_count) {
+    }
+
+    void ArriveAndWait() {
+        std::unique_lock lock(mutex_);
+        const size_t phase = phase_;
+        if (++arrived_ == thread_count_) {
+            arrived_ = 0;
+            ++phase_;
+            lock.unlock();
+            phase_finished_.notify_all();
+            return;
+        }
+        phase_finished_.wait(lock, [this, phase] {
+            return phase_ != phase;
+        });
+    }
+
+private:
+    const size_t thread_count_;
+    size_t arrived_ = 0;
+    size_t phase_ = 0;
+    std::mutex mutex_;
+    std::condition_variable phase_finished_;
+};
+
+// Найденный маршрут: общий вес и рёбра по порядку. Общий для всех маршрутизаторов,
+// независимо от того, как они хранят свои данные
 template <typename Weight>
+struct RouteInfo {
+    Weight weight;
+    std::vector<EdgeId> edges;
+};
+
+// Ячейка таблицы маршрутов в плоском виде: так таблица записывается в файл и загружается
+// обратно без повторного предрасчёта. Формат не зависит от типов, которыми таблица хранится в Router
+template <typename Weight>
+struct SavedRoute {
+    Weight weight;
+    uint64_t prev_edge;
+};
+
+// Маршрутизатор с предрасчитанной таблицей маршрутов между всеми парами вершин.
+// В таблице веса хранятся как TableWeight, а рёбра — как TableEdgeId: float и uint32_t
+// уменьшают её в разы ценой точности весов и предела на число рёбер графа
+template <typename Weight, typename TableWeight = Weight, typename TableEdgeId = EdgeId>
 class Router {
 private:
     using Graph = DirectedWeightedGraph<Weight>;
@@ -22,10 +77,31 @@ private:
 public:
     explicit Router(const Graph& graph);
 
-    struct RouteInfo {
-        Weight weight;
-        std::vector<EdgeId> edges;
-    };
+    using RouteInfo = graph::RouteInfo<Weight>;
+    using SavedRoute = graph::SavedRoute<Weight>;
+    // prev_edge: маршрута нет / маршрут из вершины в саму себя
+    static constexpr uint64_t SAVED_NO_ROUTE = std::numeric_limits<uint64_t>::max();
+    static constexpr uint64_t SAVED_NO_EDGE = SAVED_NO_ROUTE - 1;
+
+    // Маршрутизатор с таблицей, сохранённой ForEachSavedRoute для того же графа
+    // (vertex_count * vertex_count ячеек по строкам). Бросает std::invalid_argument,
+    // если таблица не подходит к графу: ребро ячейки не ведёт в её вершину или вес отрицателен
+    Router(const Graph& graph, const SavedRoute* routes);
+
+    // Вызывает func(const SavedRoute&) для каждой ячейки таблицы по строкам
+    template <typename Func>
+    void ForEachSavedRoute(Func func) const {
+        const TableWeight* weights = GetWeights();
+        const TableEdgeId* prev_edges = GetPrevEdges();
+        for (size_t index = 0; index < vertex_count_ * vertex_count_; ++index) {
+            if (weights[index] == INFINITE_WEIGHT) {
+                func(SavedRoute{Weight{}, SAVED_NO_ROUTE});
+            } else {
+                func(SavedRoute{static_cast<Weight>(weights[index]),
+                                prev_edges[index] == NO_EDGE ? SAVED_NO_EDGE : uint64_t{prev_edges[index]}});
+            }
+        }
+    }
 
     std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
 
@@ -34,98 +110,216 @@ public:
     }
 
     void Initialize() {
-        routes_internal_data_ = RoutesInternalData{graph_.GetVertexCount(), std::vector<std::optional<RouteInternalData>>(graph_.GetVertexCount())};
+        AllocateTable();
         InitializeRoutesInternalData(graph_);
-
-        const size_t vertex_count = graph_.GetVertexCount();
-        for (VertexId vertex_through = 0; vertex_through < vertex_count; ++vertex_through) {
-            RelaxRoutesInternalDataThroughVertex(vertex_count, vertex_through);
-        }
+        RelaxRoutesInternalData();
     }
 
 private:
-    struct RouteInternalData {
-        Weight weight;
-        std::optional<EdgeId> prev_edge;
-    };
-    using RoutesInternalData = std::vector<std::vector<std::optional<RouteInternalData>>>;
+    static_assert(std::numeric_limits<TableWeight>::has_infinity, "Router needs a table weight type with infinity");
+    static_assert(std::is_unsigned_v<TableEdgeId>, "Router needs an unsigned table edge type");
+    static_assert(alignof(TableWeight) <= alignof(uint64_t) && alignof(TableEdgeId) <= alignof(uint64_t));
+
+    // Ширина полосы столбцов, которую поток проходит по всем своим строкам, пока строка
+    // промежуточной вершины из этой полосы остаётся в кэше
+    static constexpr size_t TILE_SIZE = 512;
+    // На графах меньше этого размера запуск потоков дороже самого предрасчёта
+    static constexpr size_t PARALLEL_VERTEX_COUNT = 256;
+
+    size_t GetIndex(VertexId from, VertexId to) const {
+        return from * vertex_count_ + to;
+    }
+
+    TableWeight* GetWeights() {
+        return reinterpret_cast<TableWeight*>(table_.data());
+    }
+
+    const TableWeight* GetWeights() const {
+        return reinterpret_cast<const TableWeight*>(table_.data());
+    }
+
+    TableEdgeId* GetPrevEdges() {
+        return reinterpret_cast<TableEdgeId*>(table_.data() + prev_edges_offset_);
+    }
+
+    const TableEdgeId* GetPrevEdges() const {
+        return reinterpret_cast<const TableEdgeId*>(table_.data() + prev_edges_offset_);
+    }
+
+    // Выделяет таблицу, в которой маршрутов нет; бросает std::length_error,
+    // если номера рёбер графа не помещаются в TableEdgeId
+    void AllocateTable() {
+        if (graph_.GetEdgeCount() > NO_EDGE) {
+            throw std::length_error("Too many edges for the route table");
+        }
+        const size_t cell_count = vertex_count_ * vertex_count_;
+        const auto words = [](size_t bytes) {
+            return (bytes + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+        };
+        prev_edges_offset_ = words(cell_count * sizeof(TableWeight));
+        table_.assign(prev_edges_offset_ + words(cell_count * sizeof(TableEdgeId)), 0);
+        std::fill_n(GetWeights(), cell_count, INFINITE_WEIGHT);
+        std::fill_n(GetPrevEdges(), cell_count, NO_EDGE);
+    }
 
     void InitializeRoutesInternalData(const Graph& graph) {
-        const size_t vertex_count = graph.GetVertexCount();
-        for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
-            routes_internal_data_[vertex][vertex] = RouteInternalData{ZERO_WEIGHT, std::nullopt};
+        TableWeight* weights = GetWeights();
+        TableEdgeId* prev_edges = GetPrevEdges();
+        for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+            weights[GetIndex(vertex, vertex)] = TableWeight{};
             for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
                 const auto& edge = graph.GetEdge(edge_id);
-                if (edge.weight < ZERO_WEIGHT) {
+                if (edge.weight < Weight{}) {
                     throw std::domain_error("Edges' weights should be non-negative");
                 }
-                auto& route_internal_data = routes_internal_data_[vertex][edge.to];
-                if (!route_internal_data || route_internal_data->weight > edge.weight) {
-                    route_internal_data = RouteInternalData{edge.weight, edge_id};
+                const size_t index = GetIndex(vertex, edge.to);
+                if (weights[index] > static_cast<TableWeight>(edge.weight)) {
+                    weights[index] = static_cast<TableWeight>(edge.weight);
+                    prev_edges[index] = static_cast<TableEdgeId>(edge_id);
                 }
             }
         }
     }
 
-    void RelaxRoute(VertexId vertex_from, VertexId vertex_to, const RouteInternalData& route_from,
-                    const RouteInternalData& route_to) {
-        auto& route_relaxing = routes_internal_data_[vertex_from][vertex_to];
-        const Weight candidate_weight = route_from.weight + route_to.weight;
-        if (!route_relaxing || candidate_weight < route_relaxing->weight) {
-            route_relaxing = {candidate_weight,
-                              route_to.prev_edge ? route_to.prev_edge : route_from.prev_edge};
+    // Фаза vertex_through алгоритма Флойда — Уоршелла для строк [row_begin, row_end).
+    // Строка и столбец vertex_through в своей фазе не меняются (путь через вершину в саму себя
+    // не короче), поэтому строки одной фазы независимы и их можно обрабатывать параллельно,
+    // а результат совпадает с последовательным обходом до бита
+    void RelaxRowsThroughVertex(VertexId vertex_through, size_t row_begin, size_t row_end) {
+        const TableWeight* weights_through = GetWeights() + GetIndex(vertex_through, 0);
+        const TableEdgeId* prev_edges_through = GetPrevEdges() + GetIndex(vertex_through, 0);
+        for (size_t tile_begin = 0; tile_begin < vertex_count_; tile_begin += TILE_SIZE) {
+            const size_t tile_end = std::min(tile_begin + TILE_SIZE, vertex_count_);
+            for (VertexId vertex_from = row_begin; vertex_from < row_end; ++vertex_from) {
+                const TableWeight weight_from = GetWeights()[GetIndex(vertex_from, vertex_through)];
+                if (vertex_from == vertex_through || weight_from == INFINITE_WEIGHT) {
+                    continue;
+                }
+                TableWeight* weights_from = GetWeights() + GetIndex(vertex_from, 0);
+                TableEdgeId* prev_edges_from = GetPrevEdges() + GetIndex(vertex_from, 0);
+                // Без ветвлений: цикл векторизуется. Отсутствие маршрута — бесконечный вес,
+                // который не улучшает ни одну ячейку. Ребро ячейки через vertex_through берётся
+                // из строки vertex_through: у улучшаемого маршрута оно всегда есть
+                for (size_t vertex_to = tile_begin; vertex_to < tile_end; ++vertex_to) {
+                    const TableWeight candidate_weight = weight_from + weights_through[vertex_to];
+                    const bool is_better = candidate_weight < weights_from[vertex_to];
+                    weights_from[vertex_to] = is_better ? candidate_weight : weights_from[vertex_to];
+                    prev_edges_from[vertex_to] = is_better ? prev_edges_through[vertex_to] : prev_edges_from[vertex_to];
+                }
+            }
         }
     }
 
-    void RelaxRoutesInternalDataThroughVertex(size_t vertex_count, VertexId vertex_through) {
-        for (VertexId vertex_from = 0; vertex_from < vertex_count; ++vertex_from) {
-            if (const auto& route_from = routes_internal_data_[vertex_from][vertex_through]) {
-                for (VertexId vertex_to = 0; vertex_to < vertex_count; ++vertex_to) {
-                    if (const auto& route_to = routes_internal_data_[vertex_through][vertex_to]) {
-                        RelaxRoute(vertex_from, vertex_to, *route_from, *route_to);
-                    }
-                }
+    // Строки делятся между потоками поровну; после каждой фазы потоки ждут друг друга,
+    // так как следующая фаза читает строку, которую мог изменить другой поток
+    void RelaxRoutesInternalData() {
+        const size_t thread_count = vertex_count_ < PARALLEL_VERTEX_COUNT
+                                        ? 1
+                                        : std::max(1u, std::thread::hardware_concurrency());
+        if (thread_count == 1) {
+            for (VertexId vertex_through = 0; vertex_through < vertex_count_; ++vertex_through) {
+                RelaxRowsThroughVertex(vertex_through, 0, vertex_count_);
+            }
+            return;
+        }
+
+        PhaseBarrier barrier(thread_count);
+        auto relax_rows = [this, thread_count, &barrier](size_t thread_index) {
+            const size_t row_begin = vertex_count_ * thread_index / thread_count;
+            const size_t row_end = vertex_count_ * (thread_index + 1) / thread_count;
+            for (VertexId vertex_through = 0; vertex_through < vertex_count_; ++vertex_through) {
+                RelaxRowsThroughVertex(vertex_through, row_begin, row_end);
+                barrier.ArriveAndWait();
             }
+        };
+        std::vector<std::thread> threads;
+        threads.reserve(thread_count - 1);
+        for (size_t thread_index = 1; thread_index < thread_count; ++thread_index) {
+            threads.emplace_back(relax_rows, thread_index);
+        }
+        relax_rows(0);
+        for (auto& thread : threads) {
+            thread.join();
         }
     }
 
-    static constexpr Weight ZERO_WEIGHT{};
+    static constexpr TableWeight INFINITE_WEIGHT = std::numeric_limits<TableWeight>::infinity();
+    static constexpr TableEdgeId NO_EDGE = std::numeric_limits<TableEdgeId>::max();
+
     const Graph& graph_;
-    RoutesInternalData routes_internal_data_;
+    size_t vertex_count_;
+    // Таблица одним блоком: матрица весов кратчайших маршрутов (INFINITE_WEIGHT — маршрута нет),
+    // за ней с выравниванием матрица их последних рёбер (NO_EDGE — маршрут из вершины в саму себя).
+    // Обе матрицы vertex_count_ x vertex_count_ по строкам
+    std::vector<uint64_t> table_;
+    size_t prev_edges_offset_ = 0;
 };
 
-template <typename Weight>
-Router<Weight>::Router(const Graph& graph)
+template <typename Weight, typename TableWeight, typename TableEdgeId>
+Router<Weight, TableWeight, TableEdgeId>::Router(const Graph& graph)
     : graph_(graph)
-    , routes_internal_data_(graph.GetVertexCount(),
-                            std::vector<std::optional<RouteInternalData>>(graph.GetVertexCount()))
+    , vertex_count_(graph.GetVertexCount())
 {
-    InitializeRoutesInternalData(graph);
+    Initialize();
+}
 
-    const size_t vertex_count = graph.GetVertexCount();
-    for (VertexId vertex_through = 0; vertex_through < vertex_count; ++vertex_through) {
-        RelaxRoutesInternalDataThroughVertex(vertex_count, vertex_through);
+template <typename Weight, typename TableWeight, typename TableEdgeId>
+Router<Weight, TableWeight, TableEdgeId>::Router(const Graph& graph, const SavedRoute* routes)
+    : graph_(graph)
+    , vertex_count_(graph.GetVertexCount())
+{
+    AllocateTable();
+    TableWeight* weights = GetWeights();
+    TableEdgeId* prev_edges = GetPrevEdges();
+    const size_t edge_count = graph.GetEdgeCount();
+    for (VertexId from = 0; from < vertex_count_; ++from) {
+        for (VertexId to = 0; to < vertex_count_; ++to, ++routes) {
+            if (routes->prev_edge == SAVED_NO_ROUTE) {
+                continue;
+            }
+            // Без ребра бывает только маршрут из вершины в саму себя
+            const bool is_valid = routes->weight >= Weight{}
+                && (routes->prev_edge == SAVED_NO_EDGE
+                        ? from == to
+                        : routes->prev_edge < edge_count && graph.GetEdge(routes->prev_edge).to == to);
+            if (!is_valid) {
+                throw std::invalid_argument("Saved route table does not match the graph");
+            }
+            const size_t index = GetIndex(from, to);
+            weights[index] = static_cast<TableWeight>(routes->weight);
+            if (routes->prev_edge != SAVED_NO_EDGE) {
+                prev_edges[index] = static_cast<TableEdgeId>(routes->prev_edge);
+            }
+        }
     }
 }
 
-template <typename Weight>
-std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(VertexId from,
-                                                                             VertexId to) const {
-    const auto& route_internal_data = routes_internal_data_.at(from).at(to);
-    if (!route_internal_data) {
+template <typename Weight, typename TableWeight, typename TableEdgeId>
+std::optional<typename Router<Weight, TableWeight, TableEdgeId>::RouteInfo>
+Router<Weight, TableWeight, TableEdgeId>::BuildRoute(VertexId from, VertexId to) const {
+    if (from >= vertex_count_ || to >= vertex_count_) {
+        throw std::out_of_range("Vertex is out of range");
+    }
+    const TableWeight weight = GetWeights()[GetIndex(from, to)];
+    if (weight == INFINITE_WEIGHT) {
         return std::nullopt;
     }
-    const Weight weight = route_internal_data->weight;
+    const TableEdgeId* prev_edges = GetPrevEdges();
     std::vector<EdgeId> edges;
-    for (std::optional<EdgeId> edge_id = route_internal_data->prev_edge;
-         edge_id;
-         edge_id = routes_internal_data_[from][graph_.GetEdge(*edge_id).from]->prev_edge)
+    for (TableEdgeId edge_id = prev_edges[GetIndex(from, to)];
+         edge_id != NO_EDGE;
+         edge_id = prev_edges[GetIndex(from, graph_.GetEdge(edge_id).from)])
     {
-        edges.push_back(*edge_id);
+        // Кратчайший маршрут проходит каждую вершину не больше одного раза; более длинная
+        // цепочка рёбер означает зацикленную таблицу, загруженную из файла
+        if (edges.size() == vertex_count_) {
+            throw std::logic_error("Route table contains a cycle");
+        }
+        edges.push_back(edge_id);
     }
     std::reverse(edges.begin(), edges.end());
 
-    return RouteInfo{weight, std::move(edges)};
+    return RouteInfo{static_cast<Weight>(weight), std::move(edges)};
 }
 
 }  // namespace graph
\ No newline at end of file
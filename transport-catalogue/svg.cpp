@@ -68,10 +68,15 @@ Circle& Circle::SetRadius(double radius)  {
 
 void Circle::RenderObject(const RenderContext& context) const {
     auto& out = context.out_;
-    out << "<circle cx=\""sv << center_.x << "\" cy=\""sv << center_.y << "\" "sv;
-    out << "r=\""sv << radius_ << "\" "sv;
+    out << "<circle cx=\""sv;
+    context.RenderNumber(center_.x);
+    out << "\" cy=\""sv;
+    context.RenderNumber(center_.y);
+    out << "\" r=\""sv;
+    context.RenderNumber(radius_);
+    out << "\" "sv;
     // Выводим атрибуты, унаследованные от PathProps
-    RenderAttrs(context.out_);
+    RenderAttrs(context);
     out << "/>"sv;
 }
 
@@ -90,11 +95,13 @@ void Polyline::RenderObject(const RenderContext& context) const {
             out << ' ';
         }
         is_not_first = true;
-        out << p.x << ',' << p.y;        
+        context.RenderNumber(p.x);
+        out << ',';
+        context.RenderNumber(p.y);
     }
     out << '\"';
     // Выводим атрибуты, унаследованные от PathProps
-    RenderAttrs(context.out_);
+    RenderAttrs(context);
     out << "/>"sv;
 }
 
@@ -132,8 +139,14 @@ Text& Text::SetData(std::string data) {
 
 void Text::RenderObject(const RenderContext& context) const {
     auto& out = context.out_;
-    out << "<text x=\""sv << pos_.x << "\" y=\""sv << pos_.y;
-    out << "\" dx=\""sv << offset_.x << "\" dy=\""sv << offset_.y;
+    out << "<text x=\""sv;
+    context.RenderNumber(pos_.x);
+    out << "\" y=\""sv;
+    context.RenderNumber(pos_.y);
+    out << "\" dx=\""sv;
+    context.RenderNumber(offset_.x);
+    out << "\" dy=\""sv;
+    context.RenderNumber(offset_.y);
     out << "\" font-size=\""sv << font_size_ << "\" "sv;
     if(!font_family_.empty()) {
         out << "font-family=\""sv << font_family_ << "\" "sv;
@@ -143,7 +156,7 @@ void Text::RenderObject(const RenderContext& context) const {
     }
 
     // Выводим атрибуты, унаследованные от PathProps
-    RenderAttrs(context.out_);
+    RenderAttrs(context);
 
     out << '>';
 
@@ -166,12 +179,12 @@ void Text::RenderObject(const RenderContext& context) const {
 }
 
 // ----------- Document -------------------
-void Document::Render(std::ostream& out) const {
+void Document::Render(std::ostream& out, number_format::Precision numbers) const {
     out << "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>"sv << std::endl;
     out << "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">"sv << std::endl;
 
     for (const auto& el : objects_) {
-        el->Render(out);
+        el->Render(RenderContext(out, numbers));
     }
 
     out << "</svg>"sv;
@@ -8,6 +8,8 @@
 #include <optional>
 #include <string>
 
+#include "number_format.h"
+
 namespace svg {
 
 struct Rgb {
@@ -44,6 +46,7 @@ inline const Color NoneColor{std::string("none")};
     
 struct ColorPrinter {
     std::ostream& out;
+    number_format::Precision numbers{};
 
     void operator()(std::monostate) const {
         using namespace std::literals;
@@ -58,7 +61,9 @@ struct ColorPrinter {
     }
     void operator()(Rgba color) {
         using namespace std::literals;
-        out << "rgba("sv << std::to_string(color.red) << ',' << std::to_string(color.green) << ',' << std::to_string(color.blue) << ',' << color.opacity << ')';
+        out << "rgba("sv << std::to_string(color.red) << ',' << std::to_string(color.green) << ',' << std::to_string(color.blue) << ',';
+        number_format::Write(out, color.opacity, numbers);
+        out << ')';
     }
 };
 
@@ -101,18 +106,25 @@ struct Point {
  * Хранит ссылку на поток вывода, текущее значение и шаг отступа при выводе элемента
  */
 struct RenderContext {
-    RenderContext(std::ostream& out)
-        : out_(out) {
+    RenderContext(std::ostream& out, number_format::Precision numbers = {})
+        : out_(out)
+        , numbers_(numbers) {
     }
 
-    RenderContext(std::ostream& out, int indent_step, int indent = 0)
+    RenderContext(std::ostream& out, int indent_step, int indent = 0, number_format::Precision numbers = {})
         : out_(out)
         , indent_step_(indent_step)
-        , indent_(indent) {
+        , indent_(indent)
+        , numbers_(numbers) {
     }
 
     RenderContext Indented() const {
-        return {out_, indent_step_, indent_ + indent_step_};
+        return {out_, indent_step_, indent_ + indent_step_, numbers_};
+    }
+
+    // Выводит число согласно политике numbers_, без учёта локали потока
+    void RenderNumber(double value) const {
+        number_format::Write(out_, value, numbers_);
     }
 
     void RenderIndent() const {
@@ -124,6 +136,7 @@ struct RenderContext {
     std::ostream& out_;
     int indent_step_ = 0;
     int indent_ = 0;
+    number_format::Precision numbers_;
 };
 
 /*
@@ -172,17 +185,24 @@ protected:
     ~PathProps() = default;
 
     // Метод RenderAttrs выводит в поток общие для всех путей атрибуты fill и stroke
-    void RenderAttrs(std::ostream& out) const {
+    void RenderAttrs(const RenderContext& context) const {
         using namespace std::literals;
+        std::ostream& out = context.out_;
 
         if (fill_color_) {
-            out << " fill=\""sv << *fill_color_ << "\""sv;
+            out << " fill=\""sv;
+            std::visit(ColorPrinter{out, context.numbers_}, *fill_color_);
+            out << "\""sv;
         }
         if (stroke_color_) {
-            out << " stroke=\""sv << *stroke_color_ << "\""sv;
+            out << " stroke=\""sv;
+            std::visit(ColorPrinter{out, context.numbers_}, *stroke_color_);
+            out << "\""sv;
         }
         if (width_) {
-            out << " stroke-width=\""sv << *width_ << "\""sv;
+            out << " stroke-width=\""sv;
+            context.RenderNumber(*width_);
+            out << "\""sv;
         }
         if (line_cap_) {
             out << " stroke-linecap=\""sv << *line_cap_ << "\""sv;
@@ -307,8 +327,8 @@ public:
     void AddPtr(std::unique_ptr<Object>&& obj) {
         objects_.push_back(std::move(obj));
     }
-    // Выводит в ostream svg-представление документа
-    void Render(std::ostream& out) const;
+    // Выводит в ostream svg-представление документа, числа — согласно политике numbers
+    void Render(std::ostream& out, number_format::Precision numbers = {}) const;
 
     // Прочие методы и данные, необходимые для реализации класса Document
 private:
@@ -1,9 +1,34 @@
 #include "transport_catalogue.h"
 
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+
 namespace transport_catalogue {
-    void TransportCatalogue::AddStop(const std::string& name, const geo::Coordinates& coordinates) {
-        stops_.push_back(std::move(domain::Stop{stops_.size(), name, std::move(coordinates)}));
+    std::string_view TransportCatalogue::RetainInput(std::string input) {
+        return retained_inputs_.emplace_back(std::move(input));
+    }
+
+    std::string_view TransportCatalogue::InternName(std::string_view name) {
+        const std::less<const char*> before;
+        for (const std::string& input : retained_inputs_) {
+            if (!before(name.data(), input.data()) && !before(input.data() + input.size(), name.data() + name.size())) {
+                return name;
+            }
+        }
+        return owned_names_.emplace_back(name);
+    }
+
+    void TransportCatalogue::AddStop(std::string_view name, const geo::Coordinates& coordinates) {
+        const auto id = static_cast<domain::StopId>(stops_.size());
+        stops_.push_back(domain::Stop{id, InternName(name), coordinates});
         ptr_stops_.emplace(std::string_view(stops_.back().name), &stops_.back());
+
+        ptr_stop_by_id_.push_back(&stops_.back());
+        stop_names_.push_back(stops_.back().name);
+        stop_coordinates_.push_back(stops_.back().coordinates);
+        is_finalized_ = false;
     }
 
     domain::Stop* TransportCatalogue::FindStop(const std::string_view& name) const {
@@ -11,27 +36,87 @@ namespace transport_catalogue {
         return result == ptr_stops_.end() ? nullptr : result->second;
     }
 
-    void TransportCatalogue::AddBus(const std::string& name, const std::vector<std::string_view>& stops) {
+    void TransportCatalogue::AddBus(std::string_view name, const std::vector<std::string_view>& stops) {
         domain::Bus bus;
-        bus.name_ = std::move(name);
+        bus.name_ = InternName(name);
         for (const std::string_view& stop : stops) {
             bus.stops_.push_back(ptr_stops_.find(stop)->second);
         }
         buses_.push_back(std::move(bus));
-        ptr_buses_.emplace(std::string_view(buses_.back().name_), &buses_.back());
+        IndexBus(buses_.back());
+    }
 
-        for (const std::string_view& stop : stops) {
-            buses_for_stop_[ptr_stops_.find(stop)->first].insert(&buses_.back());
+    void TransportCatalogue::AddBus(const domain::Bus& bus) {
+        buses_.push_back(bus);
+        buses_.back().name_ = InternName(bus.name_);
+        IndexBus(buses_.back());
+    }
+
+    void TransportCatalogue::IndexBus(domain::Bus& bus) {
+        bus.id_ = static_cast<domain::BusId>(bus_names_.size());
+        ptr_buses_.emplace(std::string_view(bus.name_), &bus);
+
+        bus_names_.push_back(bus.name_);
+        bus_is_roundtrip_.push_back(bus.is_roundtrip_ ? 1 : 0);
+        for (const domain::Stop* stop : bus.stops_) {
+            bus_stop_ids_.push_back(stop->id);
         }
+        bus_stop_offsets_.push_back(static_cast<uint32_t>(bus_stop_ids_.size()));
+        is_finalized_ = false;
     }
 
-    void TransportCatalogue::AddBus(const domain::Bus& bus) {
-        buses_.push_back(std::move(bus));
-        ptr_buses_.emplace(std::string_view(buses_.back().name_), &buses_.back());
+    void TransportCatalogue::Finalize() {
+        // Раскладываем пары (остановка, маршрут) по остановкам подсчётом (CSR),
+        // маршруты перебираются в порядке названий, чтобы списки остановок были упорядочены
+        std::vector<domain::BusId> buses_by_name(bus_names_.size());
+        for (domain::BusId id = 0; id < buses_by_name.size(); ++id) {
+            buses_by_name[id] = id;
+        }
+        std::sort(buses_by_name.begin(), buses_by_name.end(), [this](domain::BusId lhs, domain::BusId rhs) {
+            return bus_names_[lhs] < bus_names_[rhs];
+        });
+
+        std::vector<domain::BusId> last_bus(stops_.size(), NO_BUS);
+        std::vector<std::pair<domain::StopId, domain::BusId>> links;
+        for (const domain::BusId bus : buses_by_name) {
+            for (const domain::StopId stop : GetBusStops(bus)) {
+                if (last_bus[stop] != bus) {
+                    last_bus[stop] = bus;
+                    links.emplace_back(stop, bus);
+                }
+            }
+        }
+
+        stop_bus_offsets_.assign(stops_.size() + 1, 0);
+        for (const auto& [stop, bus] : links) {
+            ++stop_bus_offsets_[stop + 1];
+        }
+        for (size_t stop = 0; stop < stops_.size(); ++stop) {
+            stop_bus_offsets_[stop + 1] += stop_bus_offsets_[stop];
+        }
+        stop_bus_ids_.resize(links.size());
+        std::vector<uint32_t> positions(stop_bus_offsets_.begin(), stop_bus_offsets_.end() - 1);
+        for (const auto& [stop, bus] : links) {
+            stop_bus_ids_[positions[stop]++] = bus;
+        }
 
-        for (const auto* stop: buses_.back().stops_) {
-            buses_for_stop_[stop->name].insert(&buses_.back());
+        // Статистика маршрутов не меняется после наполнения справочника, поэтому считаем её
+        // один раз, и запросы Bus отдают готовый результат
+        bus_infos_.clear();
+        bus_infos_.reserve(bus_names_.size());
+        std::fill(last_bus.begin(), last_bus.end(), NO_BUS);
+        for (domain::BusId bus = 0; bus < bus_names_.size(); ++bus) {
+            bus_infos_.push_back(ComputeBusInfo(bus, last_bus));
         }
+
+        is_finalized_ = true;
+    }
+
+    CatalogueSnapshot TransportCatalogue::Freeze() {
+        if (!is_finalized_) {
+            Finalize();
+        }
+        return CatalogueSnapshot(*this);
     }
 
     domain::Bus* TransportCatalogue::FindBus(const std::string_view& name) const {
@@ -40,117 +125,84 @@ namespace transport_catalogue {
     }
 
     domain::BusInfo TransportCatalogue::GetBusInfo(const std::string_view& name) const {
-        domain::BusInfo result;
-
-        if (ptr_buses_.find(name) != ptr_buses_.end()) {
-            result.name = name;
-            result.count_all_stops = ptr_buses_.at(name)->stops_.size();
-            std::unordered_set<std::string_view> unique_stops;
-            for (const auto stop : ptr_buses_.at(name)->stops_) {
-                unique_stops.insert(stop->name);
-            }
-            result.count_unique_stops = unique_stops.size();
-            result.geo_length = GetBusGeoLength(name);
-            result.route_length = GetBusRouteLength(name);
-            result.route_curvature = result.route_length / result.geo_length;
+        const domain::Bus* bus = FindBus(name);
+        if (bus == nullptr) {
+            return {};
         }
-
-        return result;
+        return GetBusInfo(bus->id_);
     }
 
-    domain::StopInfo TransportCatalogue::GetStopInfo(const std::string_view& name) const {
-        domain::StopInfo result;
+    domain::BusInfo TransportCatalogue::GetBusInfo(domain::BusId id) const {
+        if (is_finalized_) {
+            return bus_infos_[id];
+        }
+        std::vector<domain::BusId> last_bus(stops_.size(), NO_BUS);
+        return ComputeBusInfo(id, last_bus);
+    }
 
-        if (ptr_stops_.find(name) != ptr_stops_.end()) {
-            result.name = name;
-            if (buses_for_stop_.find(ptr_stops_.find(name)->first) != buses_for_stop_.end()) {
-                for (const domain::Bus* bus : buses_for_stop_.find(ptr_stops_.find(name)->first)->second) {
-                    result.buses.insert(std::string_view(bus->name_));
-                }
+    domain::BusInfo TransportCatalogue::ComputeBusInfo(domain::BusId id, std::vector<domain::BusId>& last_bus) const {
+        // Длины по географии и по дорогам и число уникальных остановок считаются за один
+        // проход по маршруту; last_bus[stop] == id означает, что остановка уже встречалась
+        domain::BusInfo result;
+        result.name = bus_names_[id];
+        result.count_all_stops = bus_stop_offsets_[id + 1] - bus_stop_offsets_[id];
+        result.count_unique_stops = 0;
+        result.geo_length = 0.0;
+        result.route_length = 0.0;
+
+        const auto stops = GetBusStops(id);
+        for (auto it = stops.begin(); it != stops.end(); ++it) {
+            if (last_bus[*it] != id) {
+                last_bus[*it] = id;
+                ++result.count_unique_stops;
+            }
+            if (it != stops.begin()) {
+                result.geo_length += ComputeDistance(stop_coordinates_[*std::prev(it)], stop_coordinates_[*it]);
+                result.route_length += distances_.Get(*std::prev(it), *it);
             }
         }
+        result.route_curvature = result.route_length / result.geo_length;
 
         return result;
     }
 
-    std::deque<domain::Bus> TransportCatalogue::GetBuses() const {
-        return buses_;
-    }
-
-    double TransportCatalogue::GetBusGeoLength(const std::string_view& name) const {
-        double route_length = 0.0;
-        geo::Coordinates from {-1.0, -1.0}, to {-1.0, -1.0};
-        for (const auto stop : ptr_buses_.at(name)->stops_) {
-            if (from == geo::Coordinates {-1.0, -1.0}) { 
-                from = stop->coordinates;
-                continue;
-            }
-            if (to == geo::Coordinates {-1.0, -1.0}) {
-                to = stop->coordinates;
-                route_length += ComputeDistance(from, to);
-                continue;
-            }
-            
-            from = to;
-            to = stop->coordinates;
-            route_length += ComputeDistance(from, to);
+    domain::StopInfo TransportCatalogue::GetStopInfo(const std::string_view& name) const {
+        using namespace std::string_literals;
+        if (!is_finalized_) {
+            throw std::logic_error("GetStopInfo() before Finalize()"s);
         }
 
-        return route_length;
-    }
+        domain::StopInfo result;
 
-    double TransportCatalogue::GetBusRouteLength(const std::string_view& name) const {
-        double route_length = 0.0;
-        domain::Stop* from = nullptr;
-        domain::Stop* to = nullptr;
-        for (domain::Stop* stop : ptr_buses_.at(name)->stops_) {
-            if (from == nullptr) {
-                from = stop;
-                continue;
-            }
-            if (to == nullptr) {
-                to = stop;
-                route_length += GetDistanceStops(from, to);
-                continue;
+        if (const domain::Stop* stop = FindStop(name); stop != nullptr) {
+            result.name = name;
+            for (const domain::BusId bus : GetStopBuses(stop->id)) {
+                result.buses.insert(result.buses.end(), bus_names_[bus]);
             }
-            
-            from = to;
-            to = stop;
-
-            route_length += GetDistanceStops(from, to);
         }
 
-        return route_length;
+        return result;
     }
 
     void TransportCatalogue::SetDistanceStops(const std::string_view& from, const std::string_view& to, const double& distance) {
-        domain::Stop* ptr_from = FindStop(from);
-        domain::Stop* ptr_to = FindStop(to);
-
-        if (ptr_from != nullptr && ptr_to != nullptr) {
-            distances_.emplace(std::pair<domain::Stop*, domain::Stop*>(ptr_from, ptr_to), distance);
-        }
+        SetDistanceStops(FindStop(from), FindStop(to), distance);
     }
 
-     void TransportCatalogue::SetDistanceStops(domain::Stop* from, domain::Stop* to, const double& distance) {
+    void TransportCatalogue::SetDistanceStops(domain::Stop* from, domain::Stop* to, const double& distance) {
         if (from != nullptr && to != nullptr) {
-            distances_.emplace(std::pair<domain::Stop*, domain::Stop*>(from, to), distance);
+            distances_.Set(from->id, to->id, distance);
         }
-     }
+    }
 
     double TransportCatalogue::GetDistanceStops(domain::Stop* from, domain::Stop* to) const {
-        if (distances_.count(std::pair<domain::Stop*, domain::Stop*>(from, to)) > 0) {
-            return distances_.at(std::pair<domain::Stop*, domain::Stop*>(from, to));
-        } else if (distances_.count(std::pair<domain::Stop*, domain::Stop*>(to, from)) > 0) {
-            return distances_.at(std::pair<domain::Stop*, domain::Stop*>(to, from));
+        if (from == nullptr || to == nullptr) {
+            return 0;
         }
-
-        return 0;
+        return distances_.Get(from->id, to->id);
     }
 
-    std::unordered_map<std::pair<domain::Stop*, domain::Stop*>, double, DistanceHasher> TransportCatalogue::GetDistances() {
-        return distances_;
+    double TransportCatalogue::GetDistanceStops(domain::StopId from, domain::StopId to) const {
+        return distances_.Get(from, to);
     }
 
-    
 };
\ No newline at end of file
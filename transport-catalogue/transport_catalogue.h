@@ -7,56 +7,150 @@
 #include <unordered_map>
 #include <unordered_set>
 
+#include "catalogue_snapshot.h"
+#include "distance_table.h"
 #include "domain.h"
+#include "ranges.h"
 
 namespace transport_catalogue {    
 
-    struct DistanceHasher {
-        size_t operator() (const std::pair<domain::Stop*, domain::Stop*>& distance) const {
-            return hasher_p_(distance.first) + 31 * hasher_p_(distance.second);
-        }
-    private:
-        std::hash<domain::Stop*> hasher_p_;
-    };
-
     class TransportCatalogue {
     public:
-        void AddStop(const std::string& name, const geo::Coordinates& coordinates);
+        using StopIdsRange = ranges::Range<std::vector<domain::StopId>::const_iterator>;
+        using BusIdsRange = ranges::Range<std::vector<domain::BusId>::const_iterator>;
+        using StopsRange = ranges::Range<std::deque<domain::Stop>::const_iterator>;
+        using BusesRange = ranges::Range<std::deque<domain::Bus>::const_iterator>;
+
+        // Передаёт справочнику буфер входных данных и возвращает представление сохранённой копии.
+        // Названия, указывающие внутрь сохранённого буфера, справочник не копирует
+        std::string_view RetainInput(std::string input);
+        // Возвращает название, принадлежащее справочнику: представление внутрь сохранённого
+        // буфера возвращается как есть, остальные строки копируются в хранилище названий
+        std::string_view InternName(std::string_view name);
+
+        void AddStop(std::string_view name, const geo::Coordinates& coordinates);
         domain::Stop* FindStop(const std::string_view& name) const;
-        void AddBus(const std::string& name, const std::vector<std::string_view>& stops);
+        void AddBus(std::string_view name, const std::vector<std::string_view>& stops);
         void AddBus(const domain::Bus& bus);
         domain::Bus* FindBus(const std::string_view& name) const;
         domain::BusInfo GetBusInfo(const std::string_view& name) const;
+        domain::BusInfo GetBusInfo(domain::BusId id) const;
         domain::StopInfo GetStopInfo(const std::string_view& name) const;
 
-        std::deque<domain::Bus> GetBuses() const;
+        // Представления содержимого справочника без копирования, действительны,
+        // пока справочник жив
+        BusesRange GetBuses() const {
+            return ranges::AsRange(buses_);
+        }
+
+        template <typename Func>
+        void ForEachBus(Func func) const {
+            for (const domain::Bus& bus : buses_) {
+                func(bus);
+            }
+        }
+
+        // Вызывает func(from, to, distance) для каждого заданного расстояния
+        template <typename Func>
+        void ForEachDistance(Func func) const {
+            distances_.ForEach(func);
+        }
 
         void SetDistanceStops(const std::string_view& from, const std::string_view& to, const double& distance);
         void SetDistanceStops(domain::Stop* from, domain::Stop* to, const double& distance);
         double GetDistanceStops(domain::Stop* from, domain::Stop* to) const;
 
+        double GetDistanceStops(domain::StopId from, domain::StopId to) const;
+
+        // Завершает наполнение и строит неизменяемый снимок справочника для запросов
+        CatalogueSnapshot Freeze();
+
+        // Строит индексы, зависящие от всех маршрутов сразу (маршруты каждой остановки,
+        // статистика маршрутов). Вызывается после добавления всех маршрутов, до запросов GetStopInfo
+        void Finalize();
+
         size_t GetStopsCount() const {
             return stops_.size();
         }
 
-        std::unordered_map<std::pair<domain::Stop*, domain::Stop*>, double, DistanceHasher> GetDistances();
+        size_t GetBusesCount() const {
+            return buses_.size();
+        }
+
+        domain::Stop* GetStop(domain::StopId id) const {
+            return ptr_stop_by_id_[id];
+        }
 
-        std::deque<domain::Stop> GetAllStops() const {
-            return stops_;
+        std::string_view GetStopName(domain::StopId id) const {
+            return stop_names_[id];
+        }
+
+        const geo::Coordinates& GetStopCoordinates(domain::StopId id) const {
+            return stop_coordinates_[id];
+        }
+
+        std::string_view GetBusName(domain::BusId id) const {
+            return bus_names_[id];
+        }
+
+        bool IsRoundtrip(domain::BusId id) const {
+            return bus_is_roundtrip_[id] != 0;
+        }
+
+        // Остановки маршрута в порядке следования, для некольцевого маршрута — туда и обратно
+        StopIdsRange GetBusStops(domain::BusId id) const {
+            return {bus_stop_ids_.begin() + bus_stop_offsets_[id], bus_stop_ids_.begin() + bus_stop_offsets_[id + 1]};
+        }
+
+        // Маршруты, проходящие через остановку, в порядке названий. Доступно после Finalize
+        BusIdsRange GetStopBuses(domain::StopId id) const {
+            return {stop_bus_ids_.begin() + stop_bus_offsets_[id], stop_bus_ids_.begin() + stop_bus_offsets_[id + 1]};
+        }
+
+        const DistanceTable& GetDistances() const {
+            return distances_;
+        }
+
+        StopsRange GetAllStops() const {
+            return ranges::AsRange(stops_);
         }
 
     private:
-        double GetBusGeoLength(const std::string_view& name) const;
-        double GetBusRouteLength(const std::string_view& name) const;
+        void IndexBus(domain::Bus& bus);
+        domain::BusInfo ComputeBusInfo(domain::BusId id, std::vector<domain::BusId>& last_bus) const;
+
+        static constexpr domain::BusId NO_BUS = static_cast<domain::BusId>(-1);
+
+        // Элементы deque не перемещаются, поэтому представления строк в них стабильны
+        std::deque<std::string> retained_inputs_;
+        std::deque<std::string> owned_names_;
 
         std::deque<domain::Stop> stops_;
+        // Словари по названиям нужны только на границе API: FindStop, FindBus, Get*Info
         std::unordered_map<std::string_view, domain::Stop*> ptr_stops_;
 
         std::deque<domain::Bus> buses_;
         std::unordered_map<std::string_view, domain::Bus*> ptr_buses_;
 
-        std::unordered_map<std::string_view, std::unordered_set<const domain::Bus*>> buses_for_stop_;
+        // Плоские массивы, индексируемые StopId
+        std::vector<domain::Stop*> ptr_stop_by_id_;
+        std::vector<std::string_view> stop_names_;
+        std::vector<geo::Coordinates> stop_coordinates_;
+
+        // Плоские массивы, индексируемые BusId. Остановки маршрута id хранятся в
+        // bus_stop_ids_[bus_stop_offsets_[id] .. bus_stop_offsets_[id + 1])
+        std::vector<std::string_view> bus_names_;
+        std::vector<char> bus_is_roundtrip_;
+        std::vector<uint32_t> bus_stop_offsets_ = {0};
+        std::vector<domain::StopId> bus_stop_ids_;
+
+        // Маршруты остановки id: stop_bus_ids_[stop_bus_offsets_[id] .. stop_bus_offsets_[id + 1])
+        std::vector<uint32_t> stop_bus_offsets_;
+        std::vector<domain::BusId> stop_bus_ids_;
+        // Статистика маршрутов, индексируется BusId. Заполняется в Finalize
+        std::vector<domain::BusInfo> bus_infos_;
+        bool is_finalized_ = false;
 
-        std::unordered_map<std::pair<domain::Stop*, domain::Stop*>, double, DistanceHasher> distances_;
+        DistanceTable distances_;
     };
 };
\ No newline at end of file
@@ -1,47 +1,279 @@
 #include "transport_router.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+
+#include "mapped_file.h"
+#include "perfect_hash.h"
+
 namespace transport_router {
 
 const int MIN_IN_HOUR = 60;
 const int METERS_IN_KM = 1000;
 
-void TransportRouter::FillGraphs(transport_catalogue::TransportCatalogue& catalogue) {
-    for(const auto& bus : catalogue.GetBuses()) {
-        const auto& stops = bus.stops_;
+namespace {
+
+using namespace std::string_literals;
+
+// Файл маршрутизатора: заголовок, рёбра графа, названия маршрутов рёбер, маршруты
+// вершин-платформ и, если выбран предрасчёт всех пар, таблица маршрутов Router.
+// Каждый раздел начинается с границы 8 байт, числа записаны в порядке байтов машины
+const char CACHE_MAGIC[8] = {'T', 'C', 'R', 'O', 'U', 'T', 'E', 'R'};
+const uint32_t CACHE_VERSION = 1;
+const uint32_t BYTE_ORDER_MARK = 0x01020304;
+const size_t SECTION_ALIGNMENT = 8;
+
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t key;
+    uint64_t vertex_count;
+    uint64_t edge_count;
+    uint64_t bus_names_size;
+    uint64_t platforms_count;
+    // Сохранена ли таблица маршрутов Router
+    uint64_t has_routes;
+};
+
+// Ребро графа; название маршрута — участок раздела названий
+struct SavedEdge {
+    uint64_t from;
+    uint64_t to;
+    uint64_t span_count;
+    double weight;
+    uint32_t bus_offset;
+    uint32_t bus_size;
+};
+
+using SavedRoute = graph::Router<double>::SavedRoute;
+
+size_t AlignUp(size_t size) {
+    return (size + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+}
+
+// Смещения разделов от начала файла, вычисляются по размерам из заголовка
+struct CacheLayout {
+    explicit CacheLayout(const CacheHeader& header)
+        : edges(AlignUp(sizeof(CacheHeader)))
+        , bus_names(AlignUp(edges + header.edge_count * sizeof(SavedEdge)))
+        , platforms(AlignUp(bus_names + header.bus_names_size))
+        , routes(AlignUp(platforms + header.platforms_count * sizeof(domain::BusId)))
+        , end(routes + (header.has_routes ? header.vertex_count * header.vertex_count * sizeof(SavedRoute) : 0)) {
+    }
+
+    size_t edges;
+    size_t bus_names;
+    size_t platforms;
+    size_t routes;
+    size_t end;
+};
+
+void WritePadding(std::ostream& output, size_t offset) {
+    static const char zeros[SECTION_ALIGNMENT] = {};
+    output.write(zeros, static_cast<std::streamsize>(AlignUp(offset) - offset));
+}
+
+}  // namespace
+
+TransportRouter::TransportRouter(const RoutingSettings settings, const transport_catalogue::CatalogueSnapshot& catalogue,
+                                 const std::string& cache_path)
+    : routing_settings_(settings)
+    , catalogue_(catalogue) {
+    if (!LoadCache(cache_path)) {
+        graph_ = graph::DirectedWeightedGraph<double>(catalogue.GetStopsCount());
+        FillGraphs(catalogue);
+        InitializeRouter();
+        try {
+            SaveCache(cache_path);
+        } catch (const std::runtime_error&) {
+            // Без файла кэша следующий запуск построит маршрутизатор заново
+        }
+    }
+}
+
+uint64_t TransportRouter::GetCacheKey() const {
+    std::string key;
+    const auto append = [&key](const auto& value) {
+        key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+    append(catalogue_.GetContentHash());
+    append(routing_settings_.bus_wait_time);
+    append(routing_settings_.bus_velocity);
+    append(static_cast<int>(routing_settings_.graph_model));
+    append(static_cast<int>(routing_settings_.mode));
+    append(static_cast<uint64_t>(routing_settings_.all_pairs_vertex_limit));
+    return transport_catalogue::PerfectHash::Hash(key);
+}
+
+bool TransportRouter::LoadCache(const std::string& path) {
+    std::optional<io::MappedFile> file;
+    try {
+        file.emplace(path);
+    } catch (const std::runtime_error&) {
+        // Файла ещё нет: маршрутизатор строится и сохраняется
+        return false;
+    }
+    const std::string_view data = file->GetData();
+
+    CacheHeader header;
+    if (data.size() < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.version != CACHE_VERSION
+        || header.byte_order != BYTE_ORDER_MARK || header.key != GetCacheKey()) {
+        return false;
+    }
+    // Размеры ограничиваются длиной файла до вычисления смещений, чтобы те не переполнились.
+    // Вершины графа — остановки справочника и платформы модели с пересадками
+    if (header.edge_count > data.size() / sizeof(SavedEdge) || header.bus_names_size > data.size()
+        || header.platforms_count > data.size() / sizeof(domain::BusId)
+        || header.vertex_count != catalogue_.GetStopsCount() + header.platforms_count
+        || (header.has_routes && header.vertex_count > 0
+            && header.vertex_count > data.size() / sizeof(SavedRoute) / header.vertex_count)) {
+        return false;
+    }
+    const CacheLayout layout(header);
+    if (layout.end != data.size()) {
+        return false;
+    }
+
+    // Файл мог быть повреждён при том же ключе, поэтому каждое поле проверяется до использования
+    const auto* platforms = reinterpret_cast<const domain::BusId*>(data.data() + layout.platforms);
+    if (std::any_of(platforms, platforms + header.platforms_count, [this](domain::BusId bus) {
+            return bus >= catalogue_.GetBusesCount();
+        })) {
+        return false;
+    }
+    // Ребро проезжает не больше остановок, чем есть в самом длинном маршруте
+    size_t max_span_count = 0;
+    for (domain::BusId bus = 0; bus < catalogue_.GetBusesCount(); ++bus) {
+        max_span_count = std::max(max_span_count, catalogue_.GetBusStops(bus).size());
+    }
+    const auto* edges = reinterpret_cast<const SavedEdge*>(data.data() + layout.edges);
+    const std::string_view bus_names = data.substr(layout.bus_names, header.bus_names_size);
+    for (size_t i = 0; i < header.edge_count; ++i) {
+        const SavedEdge& edge = edges[i];
+        if (edge.from >= header.vertex_count || edge.to >= header.vertex_count || edge.span_count > max_span_count
+            || uint64_t{edge.bus_offset} + edge.bus_size > bus_names.size()
+            || !std::isfinite(edge.weight) || edge.weight < 0) {
+            return false;
+        }
+    }
+
+    graph_ = graph::DirectedWeightedGraph<double>(header.vertex_count);
+    for (size_t i = 0; i < header.edge_count; ++i) {
+        const SavedEdge& edge = edges[i];
+        graph_.AddEdge(graph::Edge<double>(edge.from, edge.to, edge.span_count,
+                                           std::string(bus_names.substr(edge.bus_offset, edge.bus_size)), edge.weight));
+    }
+    platforms_.assign(platforms, platforms + header.platforms_count);
+
+    if (header.has_routes) {
+        try {
+            router_.emplace<AllPairsRouter>(graph_, reinterpret_cast<const SavedRoute*>(data.data() + layout.routes));
+        } catch (const std::invalid_argument&) {
+            return false;
+        }
+    } else {
+        // Маршрутизаторы без таблицы всех пар строятся по загруженному графу
+        InitializeRouter();
+    }
+    return true;
+}
+
+void TransportRouter::SaveCache(const std::string& path) const {
+    const auto* all_pairs_router = std::get_if<AllPairsRouter>(&router_);
+
+    // Одинаковые названия маршрутов записываются один раз
+    std::string bus_names;
+    std::map<std::string_view, uint32_t> bus_name_offsets;
+    std::vector<SavedEdge> edges;
+    edges.reserve(graph_.GetEdgeCount());
+    for (graph::EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+        const auto& edge = graph_.GetEdge(edge_id);
+        auto it = bus_name_offsets.find(edge.bus);
+        if (it == bus_name_offsets.end()) {
+            it = bus_name_offsets.emplace(edge.bus, static_cast<uint32_t>(bus_names.size())).first;
+            bus_names += edge.bus;
+        }
+        edges.push_back(SavedEdge{edge.from, edge.to, edge.span_count, edge.weight, it->second,
+                                  static_cast<uint32_t>(edge.bus.size())});
+    }
+
+    CacheHeader header{};
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    header.byte_order = BYTE_ORDER_MARK;
+    header.key = GetCacheKey();
+    header.vertex_count = graph_.GetVertexCount();
+    header.edge_count = edges.size();
+    header.bus_names_size = bus_names.size();
+    header.platforms_count = platforms_.size();
+    header.has_routes = all_pairs_router != nullptr;
+    const CacheLayout layout(header);
+
+    // Файл заменяется целиком: процессы, отобразившие старый кэш, продолжают читать его
+    io::ReplaceFile(path, [&](std::ostream& output) {
+        output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        WritePadding(output, sizeof(header));
+        output.write(reinterpret_cast<const char*>(edges.data()), static_cast<std::streamsize>(edges.size() * sizeof(SavedEdge)));
+        output.write(bus_names.data(), static_cast<std::streamsize>(bus_names.size()));
+        WritePadding(output, layout.bus_names + bus_names.size());
+        output.write(reinterpret_cast<const char*>(platforms_.data()),
+                     static_cast<std::streamsize>(platforms_.size() * sizeof(domain::BusId)));
+        WritePadding(output, layout.platforms + platforms_.size() * sizeof(domain::BusId));
+        if (all_pairs_router != nullptr) {
+            all_pairs_router->ForEachSavedRoute([&output](const SavedRoute& route) {
+                output.write(reinterpret_cast<const char*>(&route), sizeof(route));
+            });
+        }
+    });
+}
+
+void TransportRouter::FillGraphs(const transport_catalogue::CatalogueSnapshot& catalogue) {
+    if (routing_settings_.graph_model == GraphModel::TRANSFER) {
+        FillTransferGraph(catalogue);
+    } else {
+        FillDenseGraph(catalogue);
+    }
+}
+
+void TransportRouter::FillDenseGraph(const transport_catalogue::CatalogueSnapshot& catalogue) {
+    for (domain::BusId bus = 0; bus < catalogue.GetBusesCount(); ++bus) {
+        const auto bus_stops = catalogue.GetBusStops(bus);
+        const auto stops = bus_stops.begin();
+        const size_t stops_count = static_cast<size_t>(bus_stops.end() - bus_stops.begin());
+        const std::string bus_name(catalogue.GetBusName(bus));
         double weight = routing_settings_.bus_wait_time * 1.0;
-        auto map = catalogue.GetDistances();
 
-        if (stops.size() > 1) {
-            for (size_t i = 0; i < stops.size() - 1; ++i) {
+        if (stops_count > 1) {
+            for (size_t i = 0; i < stops_count - 1; ++i) {
                 size_t span = 1;
                 weight = routing_settings_.bus_wait_time * 1.0;
-                for (size_t j = i + 1; j < stops.size(); ++j) {
+                for (size_t j = i + 1; j < stops_count; ++j) {
                     if (stops[i] != stops[j]) {
-                        auto it = map.find({ stops[j - 1], stops[j] });
-                        if (it == map.end()) {
-                            it = map.find({ stops[j], stops[j - 1] });
-                        }
-
-                        weight += (it->second * MIN_IN_HOUR) / (METERS_IN_KM * routing_settings_.bus_velocity);
-                        graph::Edge edge(stops[i]->id, stops[j]->id, span, bus.name_, weight);
+                        weight += (catalogue.GetDistance(stops[j - 1], stops[j]) * MIN_IN_HOUR)
+                            / (METERS_IN_KM * routing_settings_.bus_velocity);
+                        graph::Edge edge(stops[i], stops[j], span, bus_name, weight);
                         graph_.AddEdge(edge);
                         ++span;
                     }
                 }
             }
-            if (!bus.is_roundtrip_) {
-                for (size_t x = stops.size() - 1; x > 0; --x) {
+            if (!catalogue.IsRoundtrip(bus)) {
+                for (size_t x = stops_count - 1; x > 0; --x) {
                     weight = routing_settings_.bus_wait_time * 1.0;
                     size_t span = 1;
                     for (size_t t = x; t > 0; --t) {
                         if (stops[x] != stops[t - 1]) {
-                            auto it = map.find({ stops[t], stops[t - 1] });
-                            if (it == map.end()) {
-                                it = map.find({ stops[t - 1], stops[t] });
-                            }
-
-                            weight += (it->second * MIN_IN_HOUR) / (METERS_IN_KM * routing_settings_.bus_velocity);
-                            graph::Edge edge(stops[x]->id, stops[t - 1]->id, span, bus.name_, weight);
+                            weight += (catalogue.GetDistance(stops[t], stops[t - 1]) * MIN_IN_HOUR)
+                                / (METERS_IN_KM * routing_settings_.bus_velocity);
+                            graph::Edge edge(stops[x], stops[t - 1], span, bus_name, weight);
                             graph_.AddEdge(edge);
                             ++span;
                         }
@@ -52,16 +284,89 @@ void TransportRouter::FillGraphs(transport_catalogue::TransportCatalogue& catalo
     }
 }
 
-std::optional<RequestRouteInfo> TransportRouter::FindRoute(domain::Stop* from, domain::Stop* to) {
-    const auto route_info = router_.graph::Router<double>::BuildRoute(from->id, to->id);
+void TransportRouter::FillTransferGraph(const transport_catalogue::CatalogueSnapshot& catalogue) {
+    const size_t stops_count = catalogue.GetStopsCount();
+
+    size_t platforms_count = 0;
+    for (domain::BusId bus = 0; bus < catalogue.GetBusesCount(); ++bus) {
+        const auto bus_stops = catalogue.GetBusStops(bus);
+        platforms_count += static_cast<size_t>(bus_stops.end() - bus_stops.begin());
+    }
+    graph_ = graph::DirectedWeightedGraph<double>(stops_count + platforms_count);
+    platforms_.clear();
+    platforms_.reserve(platforms_count);
+
+    for (domain::BusId bus = 0; bus < catalogue.GetBusesCount(); ++bus) {
+        const auto bus_stops = catalogue.GetBusStops(bus);
+        const auto stops = bus_stops.begin();
+        const size_t bus_stops_count = static_cast<size_t>(bus_stops.end() - bus_stops.begin());
+        const graph::VertexId first_platform = stops_count + platforms_.size();
+
+        for (size_t i = 0; i < bus_stops_count; ++i) {
+            const graph::VertexId platform = first_platform + i;
+            platforms_.push_back(bus);
+            if (i + 1 < bus_stops_count) {
+                graph_.AddEdge(graph::Edge(stops[i], platform, 0, {}, routing_settings_.bus_wait_time * 1.0));
+                const double ride_time = (catalogue.GetDistance(stops[i], stops[i + 1]) * MIN_IN_HOUR)
+                    / (METERS_IN_KM * routing_settings_.bus_velocity);
+                graph_.AddEdge(graph::Edge(platform, platform + 1, 1, {}, ride_time));
+            }
+            if (i > 0) {
+                graph_.AddEdge(graph::Edge(platform, stops[i], 0, {}, 0.0));
+            }
+        }
+    }
+}
+
+void TransportRouter::InitializeRouter() {
+    switch (routing_settings_.mode) {
+        case RoutingMode::ALL_PAIRS:
+            router_.emplace<AllPairsRouter>(graph_);
+            break;
+        case RoutingMode::DIJKSTRA:
+            router_.emplace<OnDemandRouter>(graph_);
+            break;
+        case RoutingMode::CONTRACTION_HIERARCHY:
+            router_.emplace<HierarchyRouter>(graph_);
+            break;
+        case RoutingMode::AUTO:
+            // Router считает все пары маршрутов за O(V^3) по времени и O(V^2) по памяти,
+            // поэтому на больших графах переходим на поиск Дейкстрой по каждому запросу
+            if (graph_.GetVertexCount() <= routing_settings_.all_pairs_vertex_limit) {
+                router_.emplace<AllPairsRouter>(graph_);
+            } else {
+                router_.emplace<OnDemandRouter>(graph_);
+            }
+            break;
+    }
+}
+
+std::optional<TransportRouter::RouteInfo> TransportRouter::BuildRoute(graph::VertexId from, graph::VertexId to) const {
+    if (const auto* router = std::get_if<AllPairsRouter>(&router_)) {
+        return router->BuildRoute(from, to);
+    }
+    if (const auto* router = std::get_if<OnDemandRouter>(&router_)) {
+        return router->BuildRoute(from, to);
+    }
+    if (const auto* router = std::get_if<HierarchyRouter>(&router_)) {
+        return router->BuildRoute(from, to);
+    }
+    return std::nullopt;
+}
+
+std::optional<RequestRouteInfo> TransportRouter::FindRoute(domain::StopId from, domain::StopId to) const {
+    const auto route_info = BuildRoute(from, to);
+    if (route_info.has_value() && routing_settings_.graph_model == GraphModel::TRANSFER) {
+        return UnpackTransferRoute(*route_info);
+    }
     if(route_info.has_value()) {
         std::vector<RoutePoint> route_points;
 
         const auto& elem = route_info.value().edges;
 
         for (const auto& el : elem) {
-            const auto& edge = router_.GetGraph().GetEdge(el);
-            route_points.emplace_back(RoutePoint{catalogue_.FindStop(catalogue_.GetAllStops()[edge.from].name),
+            const auto& edge = graph_.GetEdge(el);
+            route_points.emplace_back(RoutePoint{static_cast<domain::StopId>(edge.from),
                                             static_cast<int>(edge.span_count),
                                             edge.bus,
                                             edge.weight - GetBusWaitTime()});            
@@ -72,6 +377,28 @@ std::optional<RequestRouteInfo> TransportRouter::FindRoute(domain::Stop* from, d
     }
 }
 
+RequestRouteInfo TransportRouter::UnpackTransferRoute(const RouteInfo& route_info) const {
+    // Путь в графе пересадок имеет вид: посадка (остановка -> платформа), несколько
+    // перегонов (платформа -> платформа), высадка (платформа -> остановка)
+    const size_t stops_count = catalogue_.GetStopsCount();
+    std::vector<RoutePoint> route_points;
+
+    for (const graph::EdgeId edge_id : route_info.edges) {
+        const auto& edge = graph_.GetEdge(edge_id);
+        if (edge.from < stops_count) {
+            route_points.emplace_back(RoutePoint{static_cast<domain::StopId>(edge.from),
+                                                 0,
+                                                 std::string(catalogue_.GetBusName(platforms_[edge.to - stops_count])),
+                                                 0.0});
+        } else if (edge.to >= stops_count) {
+            route_points.back().span_count += static_cast<int>(edge.span_count);
+            route_points.back().wait_time += edge.weight;
+        }
+    }
+
+    return RequestRouteInfo{route_info.weight, route_points};
+}
+
 const graph::DirectedWeightedGraph<double>& TransportRouter::GetGraph() const {
     return graph_;
 }
@@ -1,17 +1,45 @@
 #pragma once
 
+#include <cstdint>
+#include <string>
+#include <variant>
+
+#include "contraction_hierarchy.h"
+#include "dijkstra_router.h"
 #include "router.h"
-#include "transport_catalogue.h"
+#include "catalogue_snapshot.h"
 
 namespace transport_router {
 
+inline const size_t DEFAULT_ALL_PAIRS_VERTEX_LIMIT = 2000;
+
+// DENSE — ребро между каждой парой остановок одного маршрута, число рёбер растёт квадратично
+// от длины маршрута. TRANSFER — вершины-платформы маршрутов и рёбра посадки, перегона и высадки,
+// число рёбер растёт линейно
+enum class GraphModel {
+    DENSE,
+    TRANSFER,
+};
+
+enum class RoutingMode {
+    AUTO,
+    ALL_PAIRS,
+    DIJKSTRA,
+    CONTRACTION_HIERARCHY,
+};
+
 struct RoutingSettings {
     int bus_wait_time;
     double bus_velocity;
+    GraphModel graph_model = GraphModel::DENSE;
+    RoutingMode mode = RoutingMode::AUTO;
+    // В режиме AUTO для графов с большим числом вершин маршруты ищутся по запросу,
+    // без предрасчёта всех пар
+    size_t all_pairs_vertex_limit = DEFAULT_ALL_PAIRS_VERTEX_LIMIT;
 };
 
 struct RoutePoint {
-    domain::Stop* from;
+    domain::StopId from;
     int span_count;
     std::string bus;
     double wait_time;
@@ -27,15 +55,20 @@ class TransportRouter {
 public:
     TransportRouter() = default;
 
-    TransportRouter(const RoutingSettings settings, transport_catalogue::TransportCatalogue& catalogue)
+    TransportRouter(const RoutingSettings settings, const transport_catalogue::CatalogueSnapshot& catalogue)
         : routing_settings_(settings)
         , graph_(graph::DirectedWeightedGraph<double>(catalogue.GetStopsCount()))
-        , router_(graph_)
         , catalogue_(catalogue) {
             FillGraphs(catalogue);
-            router_.Initialize();
+            InitializeRouter();
     }
 
+    // Граф и таблицы маршрутизатора загружаются из файла cache_path, если он построен для того же
+    // справочника и тех же настроек; иначе строятся заново и записываются в cache_path.
+    // Кэш только ускоряет запуск: если записать его не удалось, маршрутизатор работает без него
+    TransportRouter(const RoutingSettings settings, const transport_catalogue::CatalogueSnapshot& catalogue,
+                    const std::string& cache_path);
+
     void SetSettings(const RoutingSettings& settings) {
         routing_settings_ = settings;
     }
@@ -48,16 +81,35 @@ public:
         return routing_settings_.bus_velocity;
     }
 
-    std::optional<transport_router::RequestRouteInfo> FindRoute(domain::Stop* from, domain::Stop* to);
+    std::optional<transport_router::RequestRouteInfo> FindRoute(domain::StopId from, domain::StopId to) const;
 
 private:
+    // Веса таблицы всех пар остаются double, чтобы ответы не теряли точность; номера рёбер
+    // графа пересадок помещаются в 32 бита
+    using AllPairsRouter = graph::Router<double, double, uint32_t>;
+    using OnDemandRouter = graph::DijkstraRouter<double>;
+    using HierarchyRouter = graph::ContractionHierarchy<double>;
+    using RouteInfo = AllPairsRouter::RouteInfo;
+
     RoutingSettings routing_settings_;
     graph::DirectedWeightedGraph<double> graph_;
-    graph::Router<double> router_;
-    transport_catalogue::TransportCatalogue& catalogue_;
+    std::variant<std::monostate, AllPairsRouter, OnDemandRouter, HierarchyRouter> router_;
+    const transport_catalogue::CatalogueSnapshot& catalogue_;
+    // Маршрут каждой вершины-платформы графа пересадок, в порядке номеров вершин
+    std::vector<domain::BusId> platforms_;
 
-    void FillGraphs(transport_catalogue::TransportCatalogue& catalogue);
+    void FillGraphs(const transport_catalogue::CatalogueSnapshot& catalogue);
+    void FillDenseGraph(const transport_catalogue::CatalogueSnapshot& catalogue);
+    void FillTransferGraph(const transport_catalogue::CatalogueSnapshot& catalogue);
+    RequestRouteInfo UnpackTransferRoute(const RouteInfo& route_info) const;
+    void InitializeRouter();
+    std::optional<RouteInfo> BuildRoute(graph::VertexId from, graph::VertexId to) const;
     const graph::DirectedWeightedGraph<double>& GetGraph() const;
+
+    // Ключ файла маршрутизатора: хеш содержимого справочника и настроек маршрутизации
+    uint64_t GetCacheKey() const;
+    bool LoadCache(const std::string& path);
+    void SaveCache(const std::string& path) const;
 };
 
 };
\ No newline at end of file
@@ -0,0 +1,256 @@
+#include "unix_socket.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string_view>
+#include <system_error>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace io {
+
+using namespace std::literals;
+
+#ifdef _WIN32
+
+SocketStreambuf::SocketStreambuf(int fd)
+    : fd_(fd) {
+}
+
+SocketStreambuf::~SocketStreambuf() = default;
+
+SocketStreambuf::int_type SocketStreambuf::underflow() {
+    return traits_type::eof();
+}
+
+SocketStreambuf::int_type SocketStreambuf::overflow(int_type) {
+    return traits_type::eof();
+}
+
+int SocketStreambuf::sync() {
+    return -1;
+}
+
+bool SocketStreambuf::FlushOutput() {
+    return false;
+}
+
+void ServeUnixSocket(const std::string&, Session) {
+    throw std::runtime_error("Unix domain sockets are not supported on this platform"s);
+}
+
+#else
+
+SocketStreambuf::SocketStreambuf(int fd)
+    : fd_(fd) {
+    setg(input_, input_, input_);
+    setp(output_, output_ + BUFFER_SIZE);
+}
+
+SocketStreambuf::~SocketStreambuf() {
+    FlushOutput();
+    close(fd_);
+}
+
+SocketStreambuf::int_type SocketStreambuf::underflow() {
+    if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+    }
+    ssize_t count;
+    do {
+        count = read(fd_, input_, BUFFER_SIZE);
+    } while (count < 0 && errno == EINTR);
+    if (count <= 0) {
+        return traits_type::eof();
+    }
+    setg(input_, input_, input_ + count);
+    return traits_type::to_int_type(*gptr());
+}
+
+SocketStreambuf::int_type SocketStreambuf::overflow(int_type ch) {
+    if (!FlushOutput()) {
+        return traits_type::eof();
+    }
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+int SocketStreambuf::sync() {
+    return FlushOutput() ? 0 : -1;
+}
+
+bool SocketStreambuf::FlushOutput() {
+    const char* pos = pbase();
+    while (pos < pptr()) {
+        // MSG_NOSIGNAL: закрытое клиентом подключение даёт ошибку записи, а не SIGPIPE
+        const ssize_t count = send(fd_, pos, static_cast<size_t>(pptr() - pos), MSG_NOSIGNAL);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            setp(output_, output_ + BUFFER_SIZE);
+            return false;
+        }
+        pos += count;
+    }
+    setp(output_, output_ + BUFFER_SIZE);
+    return true;
+}
+
+namespace {
+
+// Закрывает дескриптор при выходе из области видимости
+class DescriptorGuard {
+public:
+    explicit DescriptorGuard(int fd)
+        : fd_(fd) {
+    }
+
+    DescriptorGuard(const DescriptorGuard&) = delete;
+    DescriptorGuard& operator=(const DescriptorGuard&) = delete;
+
+    ~DescriptorGuard() {
+        close(fd_);
+    }
+
+private:
+    int fd_;
+};
+
+// Состояние, общее для сервера и потоков подключений: потоки не ожидаются и могут его пережить
+struct SessionPool {
+    explicit SessionPool(Session session)
+        : session(std::move(session)) {
+    }
+
+    // Ждёт, пока число одновременных сессий станет меньше MAX_SESSIONS, и занимает место
+    void Acquire() {
+        std::unique_lock lock(mutex);
+        session_finished.wait(lock, [this] {
+            return active < MAX_SESSIONS;
+        });
+        ++active;
+    }
+
+    void Release() {
+        {
+            std::lock_guard lock(mutex);
+            --active;
+        }
+        session_finished.notify_one();
+    }
+
+    // Ограничивает число потоков и открытых дескрипторов при наплыве подключений
+    static constexpr size_t MAX_SESSIONS = 64;
+
+    const Session session;
+    std::mutex mutex;
+    std::condition_variable session_finished;
+    size_t active = 0;
+};
+
+// Ошибки accept, вызванные нехваткой ресурсов или сбоем отдельного подключения:
+// после паузы сервер продолжает принимать подключения
+bool IsTransientAcceptError(int error) {
+    switch (error) {
+        case EMFILE:
+        case ENFILE:
+        case ENOBUFS:
+        case ENOMEM:
+        case EPROTO:
+        case EPERM:
+        case EAGAIN:
+            return true;
+        default:
+            return false;
+    }
+}
+
+}  // namespace
+
+void ServeUnixSocket(const std::string& path, Session session) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Socket path is too long: "s + path);
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        throw std::runtime_error("Failed to create socket"s);
+    }
+    const DescriptorGuard listener_guard(listener);
+    unlink(path.c_str());
+    if (bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, SOMAXCONN) != 0) {
+        throw std::runtime_error("Failed to listen on "s + path);
+    }
+
+    // Потоки подключений не ожидаются, поэтому каждый держит свою ссылку на пул
+    const auto pool = std::make_shared<SessionPool>(std::move(session));
+
+    // Пауза после нехватки ресурсов растёт до секунды и сбрасывается после удачного подключения
+    constexpr auto MIN_BACKOFF = std::chrono::milliseconds(10);
+    constexpr auto MAX_BACKOFF = std::chrono::milliseconds(1000);
+    auto backoff = MIN_BACKOFF;
+    const auto wait_after = [&backoff, MAX_BACKOFF](std::string_view what) {
+        std::cerr << what << ", retrying in "sv << backoff.count() << " ms"sv << std::endl;
+        std::this_thread::sleep_for(backoff);
+        backoff = std::min(backoff * 2, MAX_BACKOFF);
+    };
+
+    while (true) {
+        pool->Acquire();
+        const int connection = accept(listener, nullptr, nullptr);
+        if (connection < 0) {
+            const int error = errno;
+            pool->Release();
+            if (error == EINTR || error == ECONNABORTED) {
+                continue;
+            }
+            if (IsTransientAcceptError(error)) {
+                wait_after("Failed to accept a connection: "s + std::strerror(error));
+                continue;
+            }
+            throw std::runtime_error("Failed to accept a connection on "s + path + ": "s + std::strerror(error));
+        }
+        // Сервер работает до завершения процесса, поэтому потоки подключений не ожидаются
+        try {
+            std::thread([connection, pool] {
+                try {
+                    SocketStreambuf buffer(connection);
+                    std::istream in(&buffer);
+                    std::ostream out(&buffer);
+                    pool->session(in, out);
+                } catch (...) {
+                    // Сбой одной сессии не должен завершать сервер
+                }
+                pool->Release();
+            }).detach();
+            backoff = MIN_BACKOFF;
+        } catch (const std::system_error& e) {
+            close(connection);
+            pool->Release();
+            wait_after("Failed to start a session thread: "s + e.what());
+        }
+    }
+}
+
+#endif
+
+}  // namespace io
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <string>
+
+namespace io {
+
+// Буфер потока поверх дескриптора подключения: чтение и запись идут блоками,
+// дескриптор закрывается вместе с буфером
+class SocketStreambuf final : public std::streambuf {
+public:
+    explicit SocketStreambuf(int fd);
+
+    SocketStreambuf(const SocketStreambuf&) = delete;
+    SocketStreambuf& operator=(const SocketStreambuf&) = delete;
+
+    ~SocketStreambuf() override;
+
+protected:
+    int_type underflow() override;
+    int_type overflow(int_type ch) override;
+    int sync() override;
+
+private:
+    static constexpr size_t BUFFER_SIZE = 1 << 14;
+
+    bool FlushOutput();
+
+    int fd_;
+    char input_[BUFFER_SIZE];
+    char output_[BUFFER_SIZE];
+};
+
+// Сессия одного подключения: читает запросы из in и пишет ответы в out
+using Session = std::function<void(std::istream& in, std::ostream& out)>;
+
+// Слушает сокет Unix по пути path (существующий файл сокета заменяется) и обслуживает
+// каждое подключение в отдельном потоке, не более 64 сессий одновременно: следующие
+// подключения ждут в очереди сокета. Нехватка дескрипторов или памяти при приёме подключения
+// выводится в std::cerr и пережидается. Возвращает управление только при отказе самого сокета,
+// бросая std::runtime_error. Вызовы session из разных потоков идут одновременно;
+// потоки подключений владеют копией session и могут пережить вызов ServeUnixSocket
+void ServeUnixSocket(const std::string& path, Session session);
+
+}  // namespace io